@@ -37,6 +37,7 @@ public class DynamicTerrain : ModuleRules
 				"Engine",
 				"RenderCore",
 				"RHI",
+				"Projects",
 			}
 			);
     }
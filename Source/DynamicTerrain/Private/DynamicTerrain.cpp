@@ -2,11 +2,19 @@
 
 #include "DynamicTerrain.h"
 
+#include "Interfaces/IPluginManager.h"
+#include "Misc/Paths.h"
+#include "ShaderCore.h"
+
 #define LOCTEXT_NAMESPACE "FDynamicTerrainModule"
 
 void FDynamicTerrainModule::StartupModule()
 {
 	// This code will execute after your module is loaded into memory; the exact timing is specified in the .uplugin file per-module
+
+	// Map the plugin shader directory so the terrain vertex factory can find its shaders
+	FString shader_directory = FPaths::Combine(IPluginManager::Get().FindPlugin(TEXT("DynamicTerrain"))->GetBaseDir(), TEXT("Shaders"));
+	AddShaderSourceDirectoryMapping(TEXT("/Plugin/DynamicTerrain"), shader_directory);
 }
 
 void FDynamicTerrainModule::ShutdownModule()
@@ -1,6 +1,13 @@
 #include "TerrainAlgorithms.h"
+#include "TerrainStat.h"
 
-#include <random>
+#include "Async/ParallelFor.h"
+#include "Math/VectorRegister.h"
+
+#include <algorithm>
+#include <cmath>
+
+DECLARE_CYCLE_STAT(TEXT("Dynamic Terrain - Poisson Fill"), STAT_DynamicTerrain_PoissonFill, STATGROUP_DynamicTerrain);
 
 constexpr float pi = 3.141592f;
 
@@ -43,6 +50,53 @@ uint32 Noise::GetHeight() const
 	return Height;
 }
 
+/// Random Numbers ///
+
+// Scramble a 64 bit value so that consecutive inputs give unrelated outputs, the SplitMix64 finalizer
+inline uint64 mix_bits(uint64 Value)
+{
+	Value = (Value ^ (Value >> 30)) * 0xbf58476d1ce4e5b9ull;
+	Value = (Value ^ (Value >> 27)) * 0x94d049bb133111ebull;
+	return Value ^ (Value >> 31);
+}
+
+FTerrainRandom::FTerrainRandom(uint32 Seed, uint32 Stream)
+{
+	Key = mix_bits(((uint64)Seed << 32 | Stream) + 0x9e3779b97f4a7c15ull);
+}
+
+FTerrainRandom FTerrainRandom::GetStream(uint32 Stream) const
+{
+	FTerrainRandom stream(0, Stream);
+	stream.Key = mix_bits(Key ^ stream.Key);
+	return stream;
+}
+
+uint32 FTerrainRandom::GetUInt(uint64 Index) const
+{
+	return (uint32)(mix_bits(Key + Index * 0x9e3779b97f4a7c15ull) >> 32);
+}
+
+float FTerrainRandom::GetFraction(uint64 Index) const
+{
+	// Use the top 24 bits, which a float holds exactly
+	return (GetUInt(Index) >> 8) * (1.0f / 16777216.0f);
+}
+
+float FTerrainRandom::GetRange(uint64 Index, float Min, float Max) const
+{
+	return Min + (Max - Min) * GetFraction(Index);
+}
+
+int32 FTerrainRandom::GetInt(uint64 Index, int32 Min, int32 Max) const
+{
+	if (Max <= Min)
+	{
+		return Min;
+	}
+	return Min + (int32)(((uint64)GetUInt(Index) * ((uint64)Max - Min + 1)) >> 32);
+}
+
 /// Gradient Noise ///
 
 GradientNoise::GradientNoise(uint32 NewWidth, uint32 NewHeight, uint32 Seed)
@@ -52,14 +106,13 @@ GradientNoise::GradientNoise(uint32 NewWidth, uint32 NewHeight, uint32 Seed)
 	Gradient = new FVector2D[Width * Height];
 
 	// Generate gradient vectors
-	std::default_random_engine rando(Seed);
-	std::uniform_real_distribution<float> dist(-pi, pi);
+	FTerrainRandom random(Seed);
 	for (unsigned y = 0; y < Height; ++y)
 	{
 		for (unsigned x = 0; x < Width; ++x)
 		{
 			// Create a unit vector from a random angle
-			float angle = dist(rando);
+			float angle = random.GetRange(y * Width + x, -pi, pi);
 			Gradient[y * Width + x].X = cos(angle);
 			Gradient[y * Width + x].Y = sin(angle);
 		}
@@ -124,6 +177,231 @@ float GradientNoise::Perlin(float X, float Y) const
 	);
 }
 
+void GradientNoise::PerlinRow(float Y, float X0, int32 Count, float* OutValues) const
+{
+	// The row stays in one line of cells, so the fade and the y terms are shared by every sample
+	Y *= ScaleY;
+	int32 y = (int32)Y;
+	Y -= y;
+	float v = fade(Y);
+
+	// Along the row each side of a cell is a linear function of the fractional x coordinate
+	int32 cell = -1;
+	float left_slope = 0.0f;
+	float left_offset = 0.0f;
+	float right_slope = 0.0f;
+	float right_offset = 0.0f;
+	auto load_cell = [&](int32 X) {
+		FVector2D g00 = Gradient[y * Width + X];
+		FVector2D g01 = Gradient[(y + 1) * Width + X];
+		FVector2D g10 = Gradient[y * Width + X + 1];
+		FVector2D g11 = Gradient[(y + 1) * Width + X + 1];
+
+		left_slope = lerp(v, g00.X, g01.X);
+		left_offset = lerp(v, g00.Y * Y, g01.Y * (Y - 1));
+		right_slope = lerp(v, g10.X, g11.X);
+		right_offset = lerp(v, g10.Y * Y, g11.Y * (Y - 1)) - right_slope;
+		cell = X;
+	};
+
+	// Sample a single scaled coordinate
+	auto sample = [&](float X) {
+		int32 x = (int32)X;
+		if (x != cell)
+		{
+			load_cell(x);
+		}
+
+		X -= x;
+		float left = left_slope * X + left_offset;
+		float right = right_slope * X + right_offset;
+		return lerp(fade(X), left, right);
+	};
+
+	const VectorRegister lane_offsets = MakeVectorRegister(0.0f, 1.0f, 2.0f, 3.0f);
+	const VectorRegister scale = VectorSetFloat1(ScaleX);
+	const VectorRegister six = VectorSetFloat1(6.0f);
+	const VectorRegister fifteen = VectorSetFloat1(-15.0f);
+	const VectorRegister ten = VectorSetFloat1(10.0f);
+
+	int32 i = 0;
+	for (; i + 4 <= Count; i += 4)
+	{
+		VectorRegister position = VectorMultiply(VectorAdd(VectorSetFloat1(X0 + i), lane_offsets), scale);
+
+		// Groups that cross into the next cell are rare when the noise is scaled up, so they fall back to single samples
+		MS_ALIGN(16) float scaled[4] GCC_ALIGN(16);
+		VectorStoreAligned(position, scaled);
+		int32 first = (int32)scaled[0];
+		if (first != (int32)scaled[3])
+		{
+			for (int32 lane = 0; lane < 4; ++lane)
+			{
+				OutValues[i + lane] = sample(scaled[lane]);
+			}
+			continue;
+		}
+
+		if (first != cell)
+		{
+			load_cell(first);
+		}
+
+		// Interpolate both sides of the cell with the fade curve of each sample
+		VectorRegister t = VectorSubtract(position, VectorSetFloat1((float)first));
+		VectorRegister u = VectorMultiply(VectorMultiply(VectorMultiply(t, t), t), VectorMultiplyAdd(t, VectorMultiplyAdd(t, six, fifteen), ten));
+		VectorRegister left = VectorMultiplyAdd(t, VectorSetFloat1(left_slope), VectorSetFloat1(left_offset));
+		VectorRegister right = VectorMultiplyAdd(t, VectorSetFloat1(right_slope), VectorSetFloat1(right_offset));
+		VectorStore(VectorMultiplyAdd(u, VectorSubtract(right, left), left), OutValues + i);
+	}
+
+	for (; i < Count; ++i)
+	{
+		OutValues[i] = sample((X0 + i) * ScaleX);
+	}
+}
+
+/// Hash Gradient Noise ///
+
+// The number of gradient directions used by hashed gradient noise
+constexpr uint32 hash_gradient_directions = 16;
+
+// Get evenly spaced unit gradients, shared by every hashed noise
+static const FVector2D* GetHashGradients()
+{
+	static const TArray<FVector2D> gradients = []() {
+		TArray<FVector2D> directions;
+		for (uint32 i = 0; i < hash_gradient_directions; ++i)
+		{
+			float angle = 2.0f * pi * i / hash_gradient_directions;
+			directions.Add(FVector2D(std::cos(angle), std::sin(angle)));
+		}
+		return directions;
+	}();
+
+	return gradients.GetData();
+}
+
+// Mix lattice coordinates and a seed into a well distributed integer
+inline uint32 hash_lattice(int32 X, int32 Y, uint32 Seed)
+{
+	uint32 h = (uint32)X * 0x8da6b343u ^ (uint32)Y * 0xd8163841u ^ Seed * 0xcb1ab31fu;
+	h ^= h >> 16;
+	h *= 0x7feb352du;
+	h ^= h >> 15;
+	h *= 0x846ca68bu;
+	h ^= h >> 16;
+	return h;
+}
+
+HashGradientNoise::HashGradientNoise(uint32 NewWidth, uint32 NewHeight, uint32 NewSeed)
+{
+	Width = NewWidth;
+	Height = NewHeight;
+	Seed = NewSeed;
+	ScaleX = 1.0f;
+	ScaleY = 1.0f;
+}
+
+void HashGradientNoise::Scale(uint32 SampleWidth, uint32 SampleHeight)
+{
+	ScaleX = (float)(Width - 1) / SampleWidth;
+	ScaleY = (float)(Height - 1) / SampleHeight;
+}
+
+void HashGradientNoise::SetFrequency(float Frequency)
+{
+	ScaleX = Frequency;
+	ScaleY = Frequency;
+}
+
+FVector2D HashGradientNoise::GetGradient(int32 X, int32 Y) const
+{
+	return GetHashGradients()[hash_lattice(X, Y, Seed) % hash_gradient_directions];
+}
+
+float HashGradientNoise::Perlin(float X, float Y) const
+{
+	// Scale noise values
+	X *= ScaleX;
+	Y *= ScaleY;
+
+	// Get the coordinates of the grid cell containing x, y, flooring so negative coordinates use the cell below them
+	int32 x = FMath::FloorToInt(X);
+	int32 y = FMath::FloorToInt(Y);
+
+	// Subtract the cell coordinates from x and y to get their fractional portion
+	X -= x;
+	Y -= y;
+
+	// Get the fade curves of the coordinates
+	float u = fade(X);
+	float v = fade(Y);
+
+	// Get the gradients at the corner of the unit cell
+	FVector2D g00 = GetGradient(x, y);
+	FVector2D g01 = GetGradient(x, y + 1);
+	FVector2D g10 = GetGradient(x + 1, y);
+	FVector2D g11 = GetGradient(x + 1, y + 1);
+
+	// Interpolate the dot products of each gradient and the cell coordinates
+	return lerp(u,
+		lerp(v, g00.X * X + g00.Y * Y,			g01.X * X + g01.Y * (Y - 1)),
+		lerp(v, g10.X * (X - 1) + g10.Y * Y,	g11.X * (X - 1) + g11.Y * (Y - 1))
+	);
+}
+
+void HashGradientNoise::PerlinRow(float Y, float X0, int32 Count, float* OutValues) const
+{
+	// The row stays in one line of cells, so the fade and the y terms are shared by every sample
+	Y *= ScaleY;
+	int32 y = FMath::FloorToInt(Y);
+	Y -= y;
+	float v = fade(Y);
+
+	// Along the row each side of a cell is a linear function of the fractional x coordinate
+	// The right side of one cell is the left side of the next, so each lattice column is hashed once
+	bool has_cell = false;
+	int32 cell = 0;
+	float left_slope = 0.0f;
+	float left_offset = 0.0f;
+	float right_slope = 0.0f;
+	float right_offset = 0.0f;
+	for (int32 i = 0; i < Count; ++i)
+	{
+		float X = (X0 + i) * ScaleX;
+		int32 x = FMath::FloorToInt(X);
+		if (!has_cell || x != cell)
+		{
+			if (has_cell && x == cell + 1)
+			{
+				left_slope = right_slope;
+				left_offset = right_offset + right_slope;
+			}
+			else
+			{
+				FVector2D g00 = GetGradient(x, y);
+				FVector2D g01 = GetGradient(x, y + 1);
+				left_slope = lerp(v, g00.X, g01.X);
+				left_offset = lerp(v, g00.Y * Y, g01.Y * (Y - 1));
+			}
+
+			FVector2D g10 = GetGradient(x + 1, y);
+			FVector2D g11 = GetGradient(x + 1, y + 1);
+			right_slope = lerp(v, g10.X, g11.X);
+			right_offset = lerp(v, g10.Y * Y, g11.Y * (Y - 1)) - right_slope;
+
+			has_cell = true;
+			cell = x;
+		}
+
+		X -= x;
+		float left = left_slope * X + left_offset;
+		float right = right_slope * X + right_offset;
+		OutValues[i] = lerp(fade(X), left, right);
+	}
+}
+
 /// Value Noise ///
 
 ValueNoise::ValueNoise(uint32 NewWidth, uint32 NewHeight, uint32 Seed)
@@ -133,13 +411,12 @@ ValueNoise::ValueNoise(uint32 NewWidth, uint32 NewHeight, uint32 Seed)
 	Value = new float[Width * Height];
 
 	// Generate random values at each grid point
-	std::default_random_engine rando(Seed);
-	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+	FTerrainRandom random(Seed);
 	for (unsigned y = 0; y < Height; ++y)
 	{
 		for (unsigned x = 0; x < Width; ++x)
 		{
-			Value[y * Width + x] = dist(rando);
+			Value[y * Width + x] = random.GetRange(y * Width + x, -1.0f, 1.0f);
 		}
 	}
 }
@@ -150,17 +427,20 @@ ValueNoise::ValueNoise(uint32 Size, uint32 Seed)
 	Height = Width;
 	Value = new float[Width * Height];
 
-	std::default_random_engine rando(Seed);
-	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+	// Each point is offset by the random value for its index, so the values don't depend on the order points are visited
+	FTerrainRandom random(Seed);
+	auto random_offset = [&random](unsigned Index) {
+		return random.GetRange(Index, -1.0f, 1.0f);
+	};
 
 	// The range of the random values generated
 	float range = 0.5;
 
 	// Generate corner values
-	Value[0] = dist(rando) * range;
-	Value[Width - 1] = dist(rando) * range;
-	Value[(Height - 1) * Width] = dist(rando) * range;
-	Value[Height * Width - 1] = dist(rando) * range;
+	Value[0] = random_offset(0) * range;
+	Value[Width - 1] = random_offset(Width - 1) * range;
+	Value[(Height - 1) * Width] = random_offset((Height - 1) * Width) * range;
+	Value[Height * Width - 1] = random_offset(Height * Width - 1) * range;
 
 	// The size of the current fractal
 	unsigned stride = Width - 1;
@@ -186,7 +466,7 @@ ValueNoise::ValueNoise(uint32 Size, uint32 Seed)
 				float v11 = Value[(y + stride) * Width + (x + stride)];
 
 				// Set the value of the current point to the average of the corners + a random value
-				Value[(y + half) * Width + (x + half)] = (v00 + v10 + v01 + v11) / 4.0f + dist(rando) * range;
+				Value[(y + half) * Width + (x + half)] = (v00 + v10 + v01 + v11) / 4.0f + random_offset((y + half) * Width + (x + half)) * range;
 			}
 		}
 
@@ -199,7 +479,7 @@ ValueNoise::ValueNoise(uint32 Size, uint32 Seed)
 			float v_right = Value[x + half];
 
 			// Set the value for the top edge at the current x coordinate to the average of the adjacent points + a random value
-			Value[x] = (v_mid + v_left + v_right) / 3.0f + dist(rando) * range;
+			Value[x] = (v_mid + v_left + v_right) / 3.0f + random_offset(x) * range;
 
 			// Get the values for the points adjacent to the bottom edge
 			v_mid = Value[(limit_y - half) * Width + x];
@@ -207,7 +487,7 @@ ValueNoise::ValueNoise(uint32 Size, uint32 Seed)
 			v_right = Value[limit_y * Width + (x + half)];
 
 			// Set the value for the bottom edge at the current x coordinate to the average of the adjacent points + a random value
-			Value[limit_y * Width + x] = (v_mid + v_left + v_right) / 3.0f + dist(rando) * range;
+			Value[limit_y * Width + x] = (v_mid + v_left + v_right) / 3.0f + random_offset(limit_y * Width + x) * range;
 		}
 
 		// Square step - left / right edges
@@ -219,7 +499,7 @@ ValueNoise::ValueNoise(uint32 Size, uint32 Seed)
 			float v_bottom = Value[(y + half) * Width];
 
 			// Set the value for the left edge at the current y coordinate to the average of the adjacent points + a random value
-			Value[y * Width] = (v_mid + v_top + v_bottom) / 3.0f + dist(rando) * range;
+			Value[y * Width] = (v_mid + v_top + v_bottom) / 3.0f + random_offset(y * Width) * range;
 
 			// Get the values for the points adjacent to the right edge
 			v_mid = Value[y * Width + (limit_x - half)];
@@ -227,7 +507,7 @@ ValueNoise::ValueNoise(uint32 Size, uint32 Seed)
 			v_bottom = Value[(y + half) * Width + limit_x];
 
 			// Set the value for the right edge at the current y coordinate to the average of the adjacent points + a random value
-			Value[y * Width + limit_x] = (v_mid + v_top + v_bottom) / 3.0f + dist(rando) * range;
+			Value[y * Width + limit_x] = (v_mid + v_top + v_bottom) / 3.0f + random_offset(y * Width + limit_x) * range;
 		}
 
 		// Square step - center points
@@ -243,7 +523,7 @@ ValueNoise::ValueNoise(uint32 Size, uint32 Seed)
 				float v_right = Value[y * Width + (x + half)];
 
 				// Set the value of the current point to the average of the adjacent points + a random value
-				Value[y * Width + x] = (v_top + v_bottom + v_left + v_right) / 4.0f + dist(rando) * range;
+				Value[y * Width + x] = (v_top + v_bottom + v_left + v_right) / 4.0f + random_offset(y * Width + x) * range;
 			}
 
 			offset = !offset;
@@ -451,22 +731,25 @@ float ValueNoise::Cubic(float X, float Y) const
 
 /// Random Point Noise ///
 
+// The average number of points in each cell of the nearest point grid
+constexpr float points_per_cell = 2.0f;
+
 PointNoise::PointNoise(uint32 XWidth, uint32 YWidth, uint32 NumPoints, uint32 Seed)
 {
 	Width = XWidth;
 	Height = YWidth;
 
 	// Generate points using random x and y values
-	std::default_random_engine rando(Seed);
-	std::uniform_real_distribution<float> x_dist(0.0f, (float)Width);
-	std::uniform_real_distribution<float> y_dist(0.0f, (float)Height);
+	FTerrainRandom random(Seed);
 
 	Points.SetNumUninitialized(NumPoints);
 	for (uint32 i = 0; i < NumPoints; ++i)
 	{
 		// Create a point
-		Points[i] = FVector2D(x_dist(rando), y_dist(rando));
+		Points[i] = FVector2D(random.GetRange(i * 2, 0.0f, (float)Width), random.GetRange(i * 2 + 1, 0.0f, (float)Height));
 	}
+
+	BuildCells();
 }
 
 PointNoise::PointNoise(uint32 Radius, uint32 NumPoints, uint32 Seed)
@@ -475,20 +758,20 @@ PointNoise::PointNoise(uint32 Radius, uint32 NumPoints, uint32 Seed)
 	Height = Width;
 
 	// Generate random x and y values within a circle
-	std::default_random_engine rando(Seed);
-	std::uniform_real_distribution<float> angle(0.0f, 360.0f);
-	std::uniform_real_distribution<float> dist;
+	FTerrainRandom random(Seed);
 
 	Points.SetNumUninitialized(NumPoints);
 	for (uint32 i = 0; i < NumPoints; ++i)
 	{
 		// Get a random angle and distance
-		float a = angle(rando);
-		float d = Radius * FMath::Sqrt(dist(rando));
+		float a = random.GetRange(i * 2, 0.0f, 360.0f);
+		float d = Radius * FMath::Sqrt(random.GetFraction(i * 2 + 1));
 
 		// Create a point
 		Points[i] = FVector2D(d * FMath::Cos(a), d * FMath::Sin(a));
 	}
+
+	BuildCells();
 }
 
 void PointNoise::Scale(uint32 SampleWidth, uint32 SampleHeight)
@@ -499,41 +782,26 @@ void PointNoise::Scale(uint32 SampleWidth, uint32 SampleHeight)
 
 FVector2D PointNoise::GetNearest(FVector2D Location) const
 {
-	// The closest point found so far
-	FVector2D nearest(0.0f, 0.0f);
-	// The distance to the closest point
-	float nearest_distance = 8.0f;
-
-	// Check each point to see which one is closest
-	for (int32 i = 0; i < Points.Num(); ++i)
-	{
-		float distance = FVector2D::DistSquared(Location, Points[i]);
-		if (distance < nearest_distance)
-		{
-			nearest_distance = distance;
-			nearest = Points[i];
-		}
-	}
-
+	FVector2D nearest;
+	float first, second;
+	FindNearest(Location, false, nearest, first, second);
 	return nearest;
 }
 
 float PointNoise::GetNearestDistance(FVector2D Location) const
 {
-	// The distance to the closest point
-	float nearest_distance = 8.0f;
-
-	// Check each point to get the distance to the nearest one
-	for (int32 i = 0; i < Points.Num(); ++i)
-	{
-		float distance = FVector2D::DistSquared(Location, Points[i]);
-		if (distance < nearest_distance)
-		{
-			nearest_distance = distance;
-		}
-	}
+	FVector2D nearest;
+	float first, second;
+	FindNearest(Location, false, nearest, first, second);
+	return FMath::Sqrt(first);
+}
 
-	return FMath::Sqrt(nearest_distance);
+FVector2D PointNoise::GetNearestDistances(FVector2D Location) const
+{
+	FVector2D nearest;
+	float first, second;
+	FindNearest(Location, true, nearest, first, second);
+	return FVector2D(FMath::Sqrt(first), FMath::Sqrt(second));
 }
 
 float PointNoise::Dot(float X, float Y) const
@@ -564,11 +832,130 @@ float PointNoise::Worley(float X, float Y) const
 	return std::min(1.0f, nearest);
 }
 
+float PointNoise::WorleyEdge(float X, float Y) const
+{
+	// Scale noise values
+	X *= ScaleX;
+	Y *= ScaleY;
+
+	// Get the distances to the two nearest points
+	FVector2D distances = GetNearestDistances(FVector2D(X, Y));
+
+	// Calculate the noise value based on their difference
+	return std::min(1.0f, distances.Y - distances.X);
+}
+
 const TArray<FVector2D>& PointNoise::GetPoints()
 {
 	return Points;
 }
 
+void PointNoise::BuildCells()
+{
+	CellStart.Reset();
+	CellPoints.Reset();
+	CellsX = 0;
+	CellsY = 0;
+	if (Points.Num() == 0)
+	{
+		return;
+	}
+
+	// Size the cells to hold a few points each on average
+	FBox2D bounds(Points);
+	FVector2D size = bounds.GetSize();
+	float area = FMath::Max(size.X, 1.0f) * FMath::Max(size.Y, 1.0f);
+	CellOrigin = bounds.Min;
+	CellSize = FMath::Sqrt(area * points_per_cell / Points.Num());
+	CellsX = FMath::FloorToInt(size.X / CellSize) + 1;
+	CellsY = FMath::FloorToInt(size.Y / CellSize) + 1;
+
+	// Count the points in each cell, then sort them with the running totals
+	TArray<int32> point_cells;
+	point_cells.SetNumUninitialized(Points.Num());
+	CellStart.SetNumZeroed(CellsX * CellsY + 1);
+	for (int32 i = 0; i < Points.Num(); ++i)
+	{
+		int32 x = FMath::Clamp(FMath::FloorToInt((Points[i].X - CellOrigin.X) / CellSize), 0, CellsX - 1);
+		int32 y = FMath::Clamp(FMath::FloorToInt((Points[i].Y - CellOrigin.Y) / CellSize), 0, CellsY - 1);
+		point_cells[i] = y * CellsX + x;
+		++CellStart[point_cells[i] + 1];
+	}
+
+	for (int32 i = 1; i < CellStart.Num(); ++i)
+	{
+		CellStart[i] += CellStart[i - 1];
+	}
+
+	TArray<int32> next = CellStart;
+	CellPoints.SetNumUninitialized(Points.Num());
+	for (int32 i = 0; i < Points.Num(); ++i)
+	{
+		CellPoints[next[point_cells[i]]++] = Points[i];
+	}
+}
+
+void PointNoise::FindNearest(FVector2D Location, bool FindSecond, FVector2D& OutNearest, float& OutFirst, float& OutSecond) const
+{
+	OutNearest = FVector2D::ZeroVector;
+	OutFirst = MAX_flt;
+	OutSecond = MAX_flt;
+	if (CellPoints.Num() == 0)
+	{
+		return;
+	}
+
+	// Start from the cell containing the location, or the closest one to it
+	int32 center_x = FMath::Clamp(FMath::FloorToInt((Location.X - CellOrigin.X) / CellSize), 0, CellsX - 1);
+	int32 center_y = FMath::Clamp(FMath::FloorToInt((Location.Y - CellOrigin.Y) / CellSize), 0, CellsY - 1);
+
+	int32 max_ring = FMath::Max(CellsX, CellsY);
+	for (int32 ring = 0; ring <= max_ring; ++ring)
+	{
+		for (int32 y = center_y - ring; y <= center_y + ring; ++y)
+		{
+			if (y < 0 || y >= CellsY)
+			{
+				continue;
+			}
+
+			// The top and bottom rows of the ring are searched completely, the other rows only at their ends
+			bool edge_row = y == center_y - ring || y == center_y + ring;
+			int32 step = edge_row ? 1 : ring * 2;
+			for (int32 x = center_x - ring; x <= center_x + ring; x += step)
+			{
+				if (x < 0 || x >= CellsX)
+				{
+					continue;
+				}
+
+				int32 cell = y * CellsX + x;
+				for (int32 i = CellStart[cell]; i < CellStart[cell + 1]; ++i)
+				{
+					float distance = FVector2D::DistSquared(Location, CellPoints[i]);
+					if (distance < OutFirst)
+					{
+						OutSecond = OutFirst;
+						OutFirst = distance;
+						OutNearest = CellPoints[i];
+					}
+					else if (distance < OutSecond)
+					{
+						OutSecond = distance;
+					}
+				}
+			}
+		}
+
+		// Every point in the next ring is at least this far from the location
+		float ring_distance = ring * CellSize;
+		if ((FindSecond ? OutSecond : OutFirst) <= ring_distance * ring_distance)
+		{
+			break;
+		}
+	}
+}
+
 /// Grid Aligned Point Noise ///
 
 UniformPointNoise::UniformPointNoise(uint32 NewWidth, uint32 NewHeight, uint32 Seed)
@@ -577,8 +964,7 @@ UniformPointNoise::UniformPointNoise(uint32 NewWidth, uint32 NewHeight, uint32 S
 	Height = NewHeight;
 
 	// Generate points at random locations within a unit grid
-	std::default_random_engine rando(Seed);
-	std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+	FTerrainRandom random(Seed);
 
 	Points.SetNumUninitialized(Width * Height);
 	for (uint32 y = 0; y < Height; ++y)
@@ -586,10 +972,12 @@ UniformPointNoise::UniformPointNoise(uint32 NewWidth, uint32 NewHeight, uint32 S
 		for (uint32 x = 0; x < Width; ++x)
 		{
 			uint32 loc = x + y * Width;
-			Points[loc].X = x + dist(rando);
-			Points[loc].Y = y + dist(rando);
+			Points[loc].X = x + random.GetFraction(loc * 2);
+			Points[loc].Y = y + random.GetFraction(loc * 2 + 1);
 		}
 	}
+
+	BuildCells();
 }
 
 inline FVector2D UniformPointNoise::GetNearest(FVector2D Location) const
@@ -601,7 +989,7 @@ inline FVector2D UniformPointNoise::GetNearest(FVector2D Location) const
 	// The closest point found so far
 	FVector2D nearest(0.0f, 0.0f);
 	// The distance to the closest point
-	float nearest_distance = 8.0f;
+	float nearest_distance = MAX_flt;
 
 	// Check each grid cell surrounding the cell containing to current point
 	for (uint32 y = 0; y < 3; ++y)
@@ -634,7 +1022,7 @@ float UniformPointNoise::GetNearestDistance(FVector2D Location) const
 	int32 miny = (int32)Location.Y - 1;
 
 	// The distance to the closest point
-	float nearest_distance = 8.0f;
+	float nearest_distance = MAX_flt;
 
 	// Check each grid cell surrounding the cell containing to current point
 	for (uint32 y = 0; y < 3; ++y)
@@ -665,6 +1053,13 @@ float UniformPointNoise::GetNearestDistance(FVector2D Location) const
 constexpr float grid_range = 1.42;
 // The number of samples to attempt for each algorithm
 constexpr uint32 num_samples = 20;
+// The width of the tiles filled in parallel in sorting grid cells, much wider than the cells a tile reads around itself
+constexpr int32 poisson_tile_cells = 32;
+// Points up to two radii outside of a tile can place points in it
+constexpr int32 poisson_border_cells = 3;
+
+// The value of sorting grid cells that don't hold a point
+static const FVector2D empty_cell(-MAX_flt, -MAX_flt);
 
 PoissonPointNoise::PoissonPointNoise(uint32 SpaceWidth, uint32 SpaceHeight, float SampleRadius, uint32 NumPoints, uint32 Seed)
 {
@@ -674,10 +1069,8 @@ PoissonPointNoise::PoissonPointNoise(uint32 SpaceWidth, uint32 SpaceHeight, floa
 	// Resize the sorting grid
 	InitializeSortingGrid(SampleRadius);
 
-	// Generate points using random x and y values
-	std::default_random_engine rando(Seed);
-	std::uniform_real_distribution<float> x_dist(0.0f, (float)Width);
-	std::uniform_real_distribution<float> y_dist(0.0f, (float)Height);
+	// Generate points using random x and y values, each attempt has its own index
+	FTerrainRandom random(Seed);
 
 	// Generate points
 	Points.Reserve(NumPoints);
@@ -687,17 +1080,20 @@ PoissonPointNoise::PoissonPointNoise(uint32 SpaceWidth, uint32 SpaceHeight, floa
 		for (uint32 j = 0; j < num_samples; ++j)
 		{
 			// Create a new random point and test it
-			FVector2D point(x_dist(rando), y_dist(rando));
+			uint64 index = ((uint64)i * num_samples + j) * 2;
+			FVector2D point(random.GetRange(index, 0.0f, (float)Width), random.GetRange(index + 1, 0.0f, (float)Height));
 			if (GetNearestDistance(point, SampleRadius) > SampleRadius)
 			{
 				// Add the point
 				Points.Add(point);
-				SortPoint(Points.Num() - 1);
+				SortPoint(point);
 
 				break;
 			}
 		}
 	}
+
+	BuildCells();
 }
 
 PoissonPointNoise::PoissonPointNoise(uint32 SpaceRadius, float SampleRadius, uint32 NumPoints, uint32 Seed)
@@ -708,32 +1104,33 @@ PoissonPointNoise::PoissonPointNoise(uint32 SpaceRadius, float SampleRadius, uin
 	// Resize the sorting grid
 	InitializeSortingGrid(SampleRadius);
 
-	// Generate points using random x and y values
-	std::default_random_engine rando(Seed);
-	std::uniform_real_distribution<float> angle(0.0f, 360.0f);
-	std::uniform_real_distribution<float> dist;
+	// Generate points using random x and y values, each attempt has its own index
+	FTerrainRandom random(Seed);
 
 	// Generate points
 	Points.Reserve(NumPoints);
 	for (uint32 i = 0; i < NumPoints; ++i)
 	{
 		// Try multiple samples for each point
-		for (int32 j = 0; j < 20; ++j)
+		for (uint32 j = 0; j < num_samples; ++j)
 		{
 			// Create a new random point and test it
-			float a = angle(rando);
-			float d = SpaceRadius * FMath::Sqrt(dist(rando));
+			uint64 index = ((uint64)i * num_samples + j) * 2;
+			float a = random.GetRange(index, 0.0f, 2.0f * PI);
+			float d = SpaceRadius * FMath::Sqrt(random.GetFraction(index + 1));
 			FVector2D point(d * FMath::Cos(a) + SpaceRadius, d * FMath::Sin(a) + SpaceRadius);
 			if (GetNearestDistance(point, SampleRadius) > SampleRadius)
 			{
 				// Add the point
 				Points.Add(point);
-				SortPoint(Points.Num() - 1);
+				SortPoint(point);
 
 				break;
 			}
 		}
 	}
+
+	BuildCells();
 }
 
 PoissonPointNoise::PoissonPointNoise(uint32 SpaceWidth, uint32 SpaceHeight, float SampleRadius, uint32 Seed)
@@ -744,43 +1141,10 @@ PoissonPointNoise::PoissonPointNoise(uint32 SpaceWidth, uint32 SpaceHeight, floa
 	// Resize the sorting grid
 	InitializeSortingGrid(SampleRadius);
 
-	// Generate points using random x and y values
-	std::default_random_engine rando(Seed);
-	std::uniform_real_distribution<float> angle(0.0f, 360.0f);
-	std::uniform_real_distribution<float> dist;
-	std::uniform_real_distribution<float> x_dist(0.0f, (float)Width);
-	std::uniform_real_distribution<float> y_dist(0.0f, (float)Height);
-
-	// Create the initial point
-	FVector2D start(x_dist(rando), y_dist(rando));
-
-	uint32 num_circles = SpaceWidth * SpaceHeight / (PI * SampleRadius * SampleRadius);
-	Points.Reserve(num_circles);
-	Points.Add(start);
-
-	SortingGrid[(uint32)(start.X / GridBound) + (uint32)(start.Y / GridBound) * GridWidth] = Points.Num() - 1;
+	// Fill the whole rectangle
+	Fill([](FVector2D Point) { return true; }, SampleRadius, Seed);
 
-	// Generate points until we have run out of candidates
-	for (int32 i = 0; i < Points.Num(); ++i)
-	{
-		for (uint32 j = 0; j < num_samples; ++j)
-		{
-			// Generate a point near the current candidate
-			float a = angle(rando);
-			float d = SampleRadius * dist(rando) + SampleRadius;
-			FVector2D point(d * FMath::Cos(a) + Points[i].X, d * FMath::Sin(a) + Points[i].Y);
-
-			// Check the point and add it if it is valid
-			if (point.X > 0 && point.Y > 0 && point.X < Width && point.Y < Height)
-			{
-				if (GetNearestDistance(point, SampleRadius) > SampleRadius)
-				{
-					Points.Add(point);
-					SortPoint(Points.Num() - 1);
-				}
-			}
-		}
-	}
+	BuildCells();
 }
 
 PoissonPointNoise::PoissonPointNoise(uint32 SpaceRadius, float SampleRadius, uint32 Seed)
@@ -791,76 +1155,44 @@ PoissonPointNoise::PoissonPointNoise(uint32 SpaceRadius, float SampleRadius, uin
 	// Resize the sorting grid
 	InitializeSortingGrid(SampleRadius);
 
-	// Generate points using random x and y values
-	std::default_random_engine rando(Seed);
-	std::uniform_real_distribution<float> angle(0.0f, 360.0f);
-	std::uniform_real_distribution<float> dist;
-
-	// Create the initial point
-	float a = angle(rando);
-	float d = SpaceRadius * FMath::Sqrt(dist(rando));
-	FVector2D start(d * FMath::Cos(a) + SpaceRadius, d * FMath::Sin(a) + SpaceRadius);
-
-	uint32 num_circles = PI * SpaceRadius * SpaceRadius / (PI * SampleRadius * SampleRadius);
-	Points.Reserve(num_circles);
-	Points.Add(start);
+	// Fill the circle inside the rectangle
+	FVector2D center((float)SpaceRadius, (float)SpaceRadius);
+	float radius_squared = (float)SpaceRadius * SpaceRadius;
+	Fill([center, radius_squared](FVector2D Point) { return FVector2D::DistSquared(center, Point) < radius_squared; }, SampleRadius, Seed);
 
-	SortingGrid[(uint32)(start.X / GridBound) + (uint32)(start.Y / GridBound) * GridWidth] = Points.Num() - 1;
-
-	FVector2D center((float)Width / 2, (float)Height / 2);
-
-	// Generate points until we have run out of candidates
-	for (int32 i = 0; i < Points.Num(); ++i)
-	{
-		for (uint32 j = 0; j < num_samples; ++j)
-		{
-			// Generate a point near the current candidate
-			a = angle(rando);
-			d = SampleRadius * dist(rando) + SampleRadius;
-			FVector2D point(d * FMath::Cos(a) + Points[i].X, d * FMath::Sin(a) + Points[i].Y);
-
-			// Check the point and add it if it is valid
-			if (FVector2D::DistSquared(center, point) < SpaceRadius * SpaceRadius)
-			{
-				if (GetNearestDistance(point, SampleRadius) > SampleRadius)
-				{
-					Points.Add(point);
-					SortPoint(Points.Num() - 1);
-				}
-			}
-		}
-	}
+	BuildCells();
 }
 
 FVector2D PoissonPointNoise::GetNearest(FVector2D Location, float SearchRadius) const
 {
 	// Calculate the number of grid cells to search and the maximum possible distance to return
-	uint32 GridRadius = (uint32)(SearchRadius / GridBound) + 1;
+	int32 GridRadius = (int32)(SearchRadius / GridBound) + 1;
 	float nearest_distance = SearchRadius * GridRadius + 1;
 	nearest_distance *= nearest_distance;
 	FVector2D nearest_point;
 
-	int32 minx = Location.X / GridBound - GridRadius;
-	int32 miny = Location.Y / GridBound - GridRadius;
+	// Clamp the searched cells to the grid so that searches don't wrap onto the next row
+	int32 cell_x = FMath::FloorToInt(Location.X / GridBound);
+	int32 cell_y = FMath::FloorToInt(Location.Y / GridBound);
+	int32 minx = FMath::Max(cell_x - GridRadius, 0);
+	int32 miny = FMath::Max(cell_y - GridRadius, 0);
+	int32 maxx = FMath::Min(cell_x + GridRadius, (int32)GridWidth - 1);
+	int32 maxy = FMath::Min(cell_y + GridRadius, (int32)GridHeight - 1);
 
 	// Check every cell around the point
-	for (uint32 y = 0; y < GridRadius * 2 + 1; ++y)
+	for (int32 y = miny; y <= maxy; ++y)
 	{
-		for (uint32 x = 0; x < GridRadius * 2 + 1; ++x)
+		for (int32 x = minx; x <= maxx; ++x)
 		{
-			// Get the cell's location in the point array
-			int32 cell = minx + x + (miny + y) * GridWidth;
-			if (cell > -1 && cell < SortingGrid.Num())
+			const FVector2D& point = SortingGrid[x + y * GridWidth];
+			if (point != empty_cell)
 			{
-				if (SortingGrid[cell] > -1)
+				// Check the distance to the point
+				float distance = FVector2D::DistSquared(Location, point);
+				if (distance < nearest_distance)
 				{
-					// Check the distance to the point
-					float distance = FVector2D::DistSquared(Location, Points[SortingGrid[cell]]);
-					if (distance < nearest_distance)
-					{
-						nearest_distance = distance;
-						nearest_point = Points[SortingGrid[cell]];
-					}
+					nearest_distance = distance;
+					nearest_point = point;
 				}
 			}
 		}
@@ -872,30 +1204,31 @@ FVector2D PoissonPointNoise::GetNearest(FVector2D Location, float SearchRadius)
 float PoissonPointNoise::GetNearestDistance(FVector2D Location, float SearchRadius) const
 {
 	// Calculate the number of grid cells to search and the maximum possible distance to return
-	uint32 GridRadius = (uint32)(SearchRadius / GridBound) + 1;
+	int32 GridRadius = (int32)(SearchRadius / GridBound) + 1;
 	float nearest_distance = SearchRadius * GridRadius + 1;
 	nearest_distance *= nearest_distance;
 
-	int32 minx = Location.X / GridBound - GridRadius;
-	int32 miny = Location.Y / GridBound - GridRadius;
+	// Clamp the searched cells to the grid so that searches don't wrap onto the next row
+	int32 cell_x = FMath::FloorToInt(Location.X / GridBound);
+	int32 cell_y = FMath::FloorToInt(Location.Y / GridBound);
+	int32 minx = FMath::Max(cell_x - GridRadius, 0);
+	int32 miny = FMath::Max(cell_y - GridRadius, 0);
+	int32 maxx = FMath::Min(cell_x + GridRadius, (int32)GridWidth - 1);
+	int32 maxy = FMath::Min(cell_y + GridRadius, (int32)GridHeight - 1);
 
 	// Check every cell around the point
-	for (uint32 y = 0; y < GridRadius * 2 + 1; ++y)
+	for (int32 y = miny; y <= maxy; ++y)
 	{
-		for (uint32 x = 0; x < GridRadius * 2 + 1; ++x)
+		for (int32 x = minx; x <= maxx; ++x)
 		{
-			// Get the cell's location in the point array
-			int32 cell = minx + x + (miny + y) * GridWidth;
-			if (cell > -1 && cell < SortingGrid.Num())
+			const FVector2D& point = SortingGrid[x + y * GridWidth];
+			if (point != empty_cell)
 			{
-				if (SortingGrid[cell] > -1)
+				// Check the distance to the point
+				float distance = FVector2D::DistSquared(Location, point);
+				if (distance < nearest_distance)
 				{
-					// Check the distance to the point
-					float distance = FVector2D::DistSquared(Location, Points[SortingGrid[cell]]);
-					if (distance < nearest_distance)
-					{
-						nearest_distance = distance;
-					}
+					nearest_distance = distance;
 				}
 			}
 		}
@@ -910,16 +1243,154 @@ void PoissonPointNoise::InitializeSortingGrid(float MinRadius)
 	GridWidth = (Width / GridBound) + 1;
 	GridHeight = (Height / GridBound) + 1;
 
-	SortingGrid.SetNumUninitialized(GridWidth * GridHeight);
-	for (int32 i = 0; i < SortingGrid.Num(); ++i)
+	SortingGrid.Init(empty_cell, GridWidth * GridHeight);
+}
+
+void PoissonPointNoise::SortPoint(FVector2D Point)
+{
+	uint32 x = Point.X / GridBound;
+	uint32 y = Point.Y / GridBound;
+	SortingGrid[x + y * GridWidth] = Point;
+}
+
+void PoissonPointNoise::Fill(TFunctionRef<bool(FVector2D)> InSpace, float SampleRadius, uint32 Seed)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DynamicTerrain_PoissonFill);
+
+	// Each tile draws from its own stream
+	FTerrainRandom random(Seed);
+
+	int32 tiles_x = FMath::DivideAndRoundUp((int32)GridWidth, poisson_tile_cells);
+	int32 tiles_y = FMath::DivideAndRoundUp((int32)GridHeight, poisson_tile_cells);
+
+	// Fill the tiles in four colours, tiles of the same colour are a tile apart so none of them reads the cells another writes
+	for (int32 colour = 0; colour < 4; ++colour)
+	{
+		int32 offset_x = colour % 2;
+		int32 offset_y = colour / 2;
+		int32 colour_x = (tiles_x - offset_x + 1) / 2;
+		int32 colour_y = (tiles_y - offset_y + 1) / 2;
+
+		ParallelFor(colour_x * colour_y, [&](int32 Index)
+		{
+			int32 tile_x = (Index % colour_x) * 2 + offset_x;
+			int32 tile_y = (Index / colour_x) * 2 + offset_y;
+
+			FIntRect tile(FIntPoint(tile_x, tile_y) * poisson_tile_cells, FIntPoint(tile_x + 1, tile_y + 1) * poisson_tile_cells);
+			tile.Max = tile.Max.ComponentMin(FIntPoint(GridWidth, GridHeight));
+
+			FillTile(tile, InSpace, SampleRadius, random.GetStream(tile_y * tiles_x + tile_x));
+		}, colour_x * colour_y < 2);
+	}
+
+	// Collect the points in the order of their cells
+	Points.Reset();
+	for (const FVector2D& point : SortingGrid)
 	{
-		SortingGrid[i] = -1;
+		if (point != empty_cell)
+		{
+			Points.Add(point);
+		}
 	}
 }
 
-void PoissonPointNoise::SortPoint(int32 PointIndex)
+void PoissonPointNoise::FillTile(const FIntRect& Tile, TFunctionRef<bool(FVector2D)> InSpace, float SampleRadius, const FTerrainRandom& Random)
 {
-	uint32 x = Points[PointIndex].X / GridBound;
-	uint32 y = Points[PointIndex].Y / GridBound;
-	SortingGrid[x + y * GridWidth] = PointIndex;
+	// Points can only be placed in cells of the tile
+	auto in_tile = [&](FVector2D Point)
+	{
+		return Point.X >= 0.0f && Point.Y >= 0.0f && Point.X < Width && Point.Y < Height
+			&& Tile.Contains(FIntPoint(FMath::FloorToInt(Point.X / GridBound), FMath::FloorToInt(Point.Y / GridBound)))
+			&& InSpace(Point);
+	};
+
+	// The points of neighbouring tiles that are already filled grow into this one, so spacing is kept across the border
+	TArray<FVector2D> active;
+	int32 minx = FMath::Max(Tile.Min.X - poisson_border_cells, 0);
+	int32 miny = FMath::Max(Tile.Min.Y - poisson_border_cells, 0);
+	int32 maxx = FMath::Min(Tile.Max.X + poisson_border_cells, (int32)GridWidth);
+	int32 maxy = FMath::Min(Tile.Max.Y + poisson_border_cells, (int32)GridHeight);
+	for (int32 y = miny; y < maxy; ++y)
+	{
+		for (int32 x = minx; x < maxx; ++x)
+		{
+			const FVector2D& point = SortingGrid[x + y * GridWidth];
+			if (point != empty_cell && !Tile.Contains(FIntPoint(x, y)))
+			{
+				active.Add(point);
+			}
+		}
+	}
+
+	// Start the tile with a random point, for tiles without filled neighbours or with space the neighbours can't reach
+	FVector2D tile_min = FVector2D(Tile.Min) * GridBound;
+	FVector2D tile_max(FMath::Min(Tile.Max.X * GridBound, (float)Width), FMath::Min(Tile.Max.Y * GridBound, (float)Height));
+	for (uint32 i = 0; i < num_samples; ++i)
+	{
+		FVector2D point(Random.GetRange(i * 2, tile_min.X, tile_max.X), Random.GetRange(i * 2 + 1, tile_min.Y, tile_max.Y));
+		if (in_tile(point) && GetNearestDistance(point, SampleRadius) > SampleRadius)
+		{
+			SortPoint(point);
+			active.Add(point);
+			break;
+		}
+	}
+
+	// Place points around random active points until none of them has room left around it
+	uint32 step = 1;
+	auto grow = [&]()
+	{
+		for (; active.Num() > 0; ++step)
+		{
+			FTerrainRandom attempts = Random.GetStream(step);
+			int32 pick = attempts.GetInt(0, 0, active.Num() - 1);
+			FVector2D origin = active[pick];
+
+			bool placed = false;
+			for (uint32 j = 0; j < num_samples && !placed; ++j)
+			{
+				// Attempts are spread evenly over the ring between one and two radii from the active point
+				float a = attempts.GetRange(j * 2 + 1, 0.0f, 2.0f * PI);
+				float d = SampleRadius * FMath::Sqrt(1.0f + 3.0f * attempts.GetFraction(j * 2 + 2));
+				FVector2D point(d * FMath::Cos(a) + origin.X, d * FMath::Sin(a) + origin.Y);
+
+				if (in_tile(point) && GetNearestDistance(point, SampleRadius) > SampleRadius)
+				{
+					SortPoint(point);
+					active.Add(point);
+					placed = true;
+				}
+			}
+
+			// Retire points that failed every attempt
+			if (!placed)
+			{
+				active.RemoveAtSwap(pick);
+			}
+		}
+	};
+	grow();
+
+	// Seed the space that neither the neighbours nor the random start reached, such as a sliver of the space in a corner of the tile
+	// Every empty cell gets one attempt, and a point that lands is grown like the first
+	FTerrainRandom reseeds = Random.GetStream(0);
+	for (int32 y = Tile.Min.Y; y < Tile.Max.Y; ++y)
+	{
+		for (int32 x = Tile.Min.X; x < Tile.Max.X; ++x)
+		{
+			if (SortingGrid[x + y * GridWidth] != empty_cell)
+			{
+				continue;
+			}
+
+			uint64 index = ((uint64)y * GridWidth + x) * 2;
+			FVector2D point((x + reseeds.GetFraction(index)) * GridBound, (y + reseeds.GetFraction(index + 1)) * GridBound);
+			if (in_tile(point) && GetNearestDistance(point, SampleRadius) > SampleRadius)
+			{
+				SortPoint(point);
+				active.Add(point);
+				grow();
+			}
+		}
+	}
 }
\ No newline at end of file
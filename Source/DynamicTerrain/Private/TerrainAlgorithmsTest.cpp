@@ -0,0 +1,109 @@
+#include "TerrainAlgorithms.h"
+
+#include "Misc/AutomationTest.h"
+#include "HAL/PlatformTime.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+// The largest difference allowed between a vectorized row and scalar samples
+constexpr float perlin_row_tolerance = 1e-4f;
+// The number of cells of gradients in the tested noise
+constexpr uint32 perlin_test_cells = 17;
+// The width and height of the area sampled by the benchmark, the size of a large heightmap
+constexpr int32 perlin_benchmark_width = 2048;
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGradientNoisePerlinRowTest, "DynamicTerrain.Algorithms.GradientNoise.PerlinRow",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::EngineFilter)
+
+bool FGradientNoisePerlinRowTest::RunTest(const FString& Parameters)
+{
+	// Few samples per cell put a cell boundary inside most groups of four, many samples per cell keep most groups within one cell
+	const int32 sample_widths[] = { 7, 64, 509 };
+	// Counts below, at and above the group size, with and without a partial group at the end
+	const int32 counts[] = { 1, 3, 4, 5, 13, 64 };
+
+	TArray<float> row;
+	for (int32 sample_width : sample_widths)
+	{
+		GradientNoise noise(perlin_test_cells, perlin_test_cells, 12345);
+		noise.Scale(sample_width, sample_width);
+
+		const float rows[] = { 0.0f, sample_width * 0.37f, sample_width - 1.0f };
+		for (int32 count : counts)
+		{
+			// Start on and between samples, and so the row ends at the last sample
+			const float starts[] = { 0.0f, 1.0f, 2.5f, (float)(sample_width - count) };
+			for (float start : starts)
+			{
+				if (start < 0.0f || start + count > sample_width)
+				{
+					continue;
+				}
+
+				row.SetNumUninitialized(count);
+				for (float y : rows)
+				{
+					noise.PerlinRow(y, start, count, row.GetData());
+					for (int32 i = 0; i < count; ++i)
+					{
+						float expected = noise.Perlin(start + i, y);
+						if (!FMath::IsNearlyEqual(row[i], expected, perlin_row_tolerance))
+						{
+							AddError(FString::Printf(TEXT("PerlinRow(%f, %f, %d) sample %d is %f, Perlin is %f (sample width %d)"),
+								y, start, count, i, row[i], expected, sample_width));
+							return false;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FGradientNoisePerlinRowBenchmark, "DynamicTerrain.Algorithms.GradientNoise.PerlinRowBenchmark",
+	EAutomationTestFlags::EditorContext | EAutomationTestFlags::PerfFilter)
+
+bool FGradientNoisePerlinRowBenchmark::RunTest(const FString& Parameters)
+{
+	GradientNoise noise(perlin_test_cells, perlin_test_cells, 12345);
+	noise.Scale(perlin_benchmark_width, perlin_benchmark_width);
+	TArray<float> row;
+	row.SetNumUninitialized(perlin_benchmark_width);
+
+	// Sample the whole area one coordinate at a time, then a row at a time, summing the samples so neither loop is optimized away
+	double scalar_sum = 0.0;
+	double start_time = FPlatformTime::Seconds();
+	for (int32 y = 0; y < perlin_benchmark_width; ++y)
+	{
+		for (int32 x = 0; x < perlin_benchmark_width; ++x)
+		{
+			scalar_sum += noise.Perlin((float)x, (float)y);
+		}
+	}
+	double scalar_time = FPlatformTime::Seconds() - start_time;
+
+	double row_sum = 0.0;
+	start_time = FPlatformTime::Seconds();
+	for (int32 y = 0; y < perlin_benchmark_width; ++y)
+	{
+		noise.PerlinRow((float)y, 0.0f, perlin_benchmark_width, row.GetData());
+		for (int32 x = 0; x < perlin_benchmark_width; ++x)
+		{
+			row_sum += row[x];
+		}
+	}
+	double row_time = FPlatformTime::Seconds() - start_time;
+
+	double samples = (double)perlin_benchmark_width * perlin_benchmark_width;
+	AddInfo(FString::Printf(TEXT("Perlin: %.1f million samples/s, PerlinRow: %.1f million samples/s, %.2fx faster"),
+		samples / FMath::Max(scalar_time, SMALL_NUMBER) / 1e6, samples / FMath::Max(row_time, SMALL_NUMBER) / 1e6, scalar_time / FMath::Max(row_time, SMALL_NUMBER)));
+
+	// Both loops sample the same coordinates, so their sums only differ by rounding
+	TestTrue(TEXT("PerlinRow matches Perlin over the benchmark area"), FMath::Abs(scalar_sum - row_sum) <= samples * perlin_row_tolerance);
+
+	return true;
+}
+
+#endif
@@ -3,6 +3,7 @@
 #include "Terrain.h"
 #include "TerrainRender.h"
 #include "TerrainStat.h"
+#include "TerrainTopology.h"
 
 #include "Engine.h"
 #include "PrimitiveSceneProxy.h"
@@ -20,6 +21,8 @@ UTerrainComponent::UTerrainComponent(const FObjectInitializer& ObjectInitializer
 	Tiling = 1.0f;
 	LODs = 1;
 	LODScale = 0.5;
+	LODErrorThreshold = 1.0f;
+	ShadowLODBias = 1;
 
 	// Disable ticking for the component to save some CPU cycles
 	PrimaryComponentTick.bCanEverTick = false;
@@ -32,7 +35,7 @@ FPrimitiveSceneProxy* UTerrainComponent::CreateSceneProxy()
 	FPrimitiveSceneProxy* proxy = nullptr;
 	VerifyMapProxy();
 
-	if (Vertices.Num() > 0 && IndexBuffer.Num() > 0 && MapProxy.IsValid())
+	if (Size > 1 && MapProxy.IsValid())
 	{
 		proxy = new FTerrainComponentSceneProxy(this);
 	}
@@ -56,16 +59,29 @@ int32 UTerrainComponent::GetNumMaterials() const
 
 bool UTerrainComponent::GetPhysicsTriMeshData(struct FTriMeshCollisionData* CollisionData, bool InUseAllTriData)
 {
-	// Copy vertex and triangle data
-	CollisionData->Vertices = Vertices;
-	int32 num_triangles = IndexBuffer.Num() / 3;
+	// Components too small to have map data have no collision
+	VerifyMapProxy();
+	if (!MapProxy.IsValid())
+	{
+		return false;
+	}
+
+	if (!Topology.IsValid())
+	{
+		CreateMeshData();
+	}
+
+	// Build vertices from the map data and copy the shared triangle data
+	GetVertices(CollisionData->Vertices);
+	const TArray<uint32>& indices = Topology->GetGridIndices();
+	int32 num_triangles = indices.Num() / 3;
+	CollisionData->Indices.SetNumUninitialized(num_triangles);
 	for (int32 i = 0; i < num_triangles; ++i)
 	{
-		FTriIndices tris;
-		tris.v0 = IndexBuffer[i * 3];
-		tris.v1 = IndexBuffer[i * 3 + 1];
-		tris.v2 = IndexBuffer[i * 3 + 2];
-		CollisionData->Indices.Add(tris);
+		FTriIndices& tris = CollisionData->Indices[i];
+		tris.v0 = indices[i * 3];
+		tris.v1 = indices[i * 3 + 1];
+		tris.v2 = indices[i * 3 + 2];
 	}
 
 	CollisionData->bFlipNormals = true;
@@ -75,21 +91,47 @@ bool UTerrainComponent::GetPhysicsTriMeshData(struct FTriMeshCollisionData* Coll
 	return true;
 }
 
-FBoxSphereBounds UTerrainComponent::CalcBounds(const FTransform& LocalToWorld) const
+void UTerrainComponent::PostLoad()
 {
-	FBox bound(ForceInit);
+	Super::PostLoad();
+
+	// The saved body setup was cooked from the saved map data
+	LiveHash = CookedHash;
+}
 
-	for (int32 i = 0; i < Vertices.Num(); ++i)
+void UTerrainComponent::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize)
+{
+	Super::GetResourceSizeEx(CumulativeResourceSize);
+
+	// The map section is shared with the scene proxy, which keeps it for updates
+	if (MapProxy.IsValid())
 	{
-		bound += LocalToWorld.TransformPosition(Vertices[i]);
+		CumulativeResourceSize.AddDedicatedSystemMemoryBytes(sizeof(FMapSection) + MapProxy->Data.GetAllocatedSize());
 	}
 
-	FBoxSphereBounds boxsphere;
-	boxsphere.BoxExtent = bound.GetExtent();
-	boxsphere.Origin = bound.GetCenter();
-	boxsphere.SphereRadius = boxsphere.BoxExtent.Size();
+	// Positions, tangents and UVs are kept on the GPU and as a CPU copy in the scene proxy
+	if (SceneProxy != nullptr)
+	{
+		uint32 width = GetTerrainComponentWidth(Size);
+		SIZE_T vertex_size = width * width * (sizeof(FVector) + 2 * sizeof(FPackedNormal) + sizeof(FVector2DHalf));
+		CumulativeResourceSize.AddDedicatedSystemMemoryBytes(vertex_size);
+		CumulativeResourceSize.AddDedicatedVideoMemoryBytes(vertex_size);
+	}
+
+	// The collision body is owned by the component
+	if (BodySetup != nullptr)
+	{
+		BodySetup->GetResourceSizeEx(CumulativeResourceSize);
+	}
+}
+
+FBoxSphereBounds UTerrainComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	// The component is a grid on the XY plane spanning its height range
+	uint32 width = GetTerrainComponentWidth(Size);
+	FBox bound(FVector(0.0f, 0.0f, MinHeight), FVector(width - 1, width - 1, MaxHeight));
 
-	return boxsphere;
+	return FBoxSphereBounds(bound.TransformBy(LocalToWorld));
 }
 
 /// Terrain Interface ///
@@ -100,45 +142,62 @@ void UTerrainComponent::Initialize(ATerrain* Terrain, TSharedPtr<FMapSection, ES
 	YOffset = Y;
 	LODs = Terrain->GetNumLODs();
 	LODScale = Terrain->GetLODDistanceScale();
+	LODErrorThreshold = Terrain->GetLODErrorThreshold();
+	ShadowLODBias = Terrain->GetShadowLODBias();
 	Tiling = Terrain->GetTiling();
 	AsyncCooking = Terrain->GetAsyncCookingEnabled();
 	MapProxy = Proxy;
+	LODGrid = Terrain->GetLODGrid();
+	UploadQueue = Terrain->GetUploadQueue();
 
 	SetMaterial(0, Terrain->GetMaterials());
+
+	// Components reused at the same size keep their mesh data, so only refresh the parts that depend on the map
+	uint32 old_size = Size;
 	SetSize(Terrain->GetComponentSize());
+	if (Size == old_size && MapProxy.IsValid())
+	{
+		UpdateHeightRange();
+		UpdateCollisionVertices();
+		UpdateBounds();
+		MarkRenderStateDirty();
+	}
 }
 
 void UTerrainComponent::CreateMeshData()
 {
-	// Create vertex data
+	// Get the shared triangle data for the current size
+	Topology = FTerrainTopology::Get(Size);
+
+	// Use heights from the map proxy if it matches the new size
 	uint32 width = GetTerrainComponentWidth(Size);
-	Vertices.Empty();
-	Vertices.SetNumUninitialized(width * width);
-	for (uint32 y = 0; y < width; ++y)
+	if (MapProxy.IsValid() && MapProxy->X == width + 2 && MapProxy->Y == width + 2)
 	{
-		for (uint32 x = 0; x < width; ++x)
-		{
-			Vertices[y * width + x] = FVector(x, y, 0.0f);
-		}
+		UpdateHeightRange();
 	}
-
-	// Create triangles
-	uint32 polygons = width - 1;
-	IndexBuffer.Empty();
-	IndexBuffer.SetNumUninitialized(polygons * polygons * 6);
-	for (uint32 y = 0; y < polygons; ++y)
+	else
 	{
-		for (uint32 x = 0; x < polygons; ++x)
-		{
-			uint32 i = (y * polygons + x) * 6;
+		MinHeight = 0.0f;
+		MaxHeight = 0.0f;
+	}
+}
 
-			IndexBuffer[i] = x + (y * width);
-			IndexBuffer[i + 1] = 1 + x + (y + 1) * width;
-			IndexBuffer[i + 2] = 1 + x + y * width;
+void UTerrainComponent::GetVertices(TArray<FVector>& OutVertices)
+{
+	VerifyMapProxy();
+	if (!MapProxy.IsValid())
+	{
+		OutVertices.Reset();
+		return;
+	}
 
-			IndexBuffer[i + 3] = x + (y * width);
-			IndexBuffer[i + 4] = x + (y + 1) * width;
-			IndexBuffer[i + 5] = 1 + x + (y + 1) * width;
+	uint32 width = GetTerrainComponentWidth(Size);
+	OutVertices.SetNumUninitialized(width * width);
+	for (uint32 y = 0; y < width; ++y)
+	{
+		for (uint32 x = 0; x < width; ++x)
+		{
+			OutVertices[y * width + x] = FVector(x, y, MapProxy->Data[(y + 1) * MapProxy->X + x + 1]);
 		}
 	}
 }
@@ -166,13 +225,21 @@ void UTerrainComponent::SetTiling(float NewTiling)
 	float y = YOffset;
 
 	// Update UV data in the proxy
+	// The terrain flushes its upload queue once every component has been changed
 	FTerrainComponentSceneProxy* proxy = (FTerrainComponentSceneProxy*)SceneProxy;
-	ENQUEUE_RENDER_COMMAND(FComponentUpdate)([proxy, x, y, NewTiling](FRHICommandListImmediate& RHICmdList) {
-		proxy->UpdateUVs(x, y, NewTiling);
-		});
+	if (proxy != nullptr && UploadQueue.IsValid())
+	{
+		UploadQueue->AddUVUpdate(proxy, x, y, NewTiling);
+	}
+	else if (proxy != nullptr)
+	{
+		ENQUEUE_RENDER_COMMAND(FComponentUpdate)([proxy, x, y, NewTiling](FRHICommandListImmediate& RHICmdList) {
+			proxy->UpdateUVs(x, y, NewTiling);
+			});
+	}
 }
 
-void UTerrainComponent::SetLODs(int32 NumLODs, float DistanceScale)
+void UTerrainComponent::SetLODs(int32 NumLODs, float DistanceScale, float ErrorThreshold)
 {
 	if ((uint32)NumLODs < Size)
 	{
@@ -183,40 +250,73 @@ void UTerrainComponent::SetLODs(int32 NumLODs, float DistanceScale)
 		LODs = Size;
 	}
 	LODScale = DistanceScale;
+	LODErrorThreshold = ErrorThreshold;
 
 	// Reset the proxy to regenerate LODs
 	MarkRenderStateDirty();
 }
 
+void UTerrainComponent::SetShadowLODBias(int32 Bias)
+{
+	if (ShadowLODBias != Bias)
+	{
+		ShadowLODBias = Bias;
+		MarkRenderStateDirty();
+	}
+}
+
 void UTerrainComponent::Update(TSharedPtr<FMapSection, ESPMode::ThreadSafe> NewSection)
 {
 	MapProxy = NewSection;
 
 	// Update collision data and bounds
-	uint32 width = GetTerrainComponentWidth(Size);
-	for (uint32 y = 0; y < width; ++y)
-	{
-		for (uint32 x = 0; x < width; ++x)
-		{
-			Vertices[y * width + x].Z = MapProxy->Data[(y + 1) * NewSection->X + x + 1];
-		}
-	}
-	BodyInstance.UpdateTriMeshVertices(Vertices);
+	UpdateHeightRange();
+	UpdateCollisionVertices();
 	UpdateBounds();
 
-	// Update the scene proxy
+	// Update the scene proxy, hidden components don't have one
+	// The terrain flushes its upload queue once every component has been changed
 	FTerrainComponentSceneProxy* proxy = (FTerrainComponentSceneProxy*)SceneProxy;
-	ENQUEUE_RENDER_COMMAND(FComponentUpdate)([proxy, NewSection](FRHICommandListImmediate& RHICmdList) {
-		proxy->UpdateMap(NewSection);
-		});
+	if (proxy != nullptr && UploadQueue.IsValid())
+	{
+		UploadQueue->AddMapUpdate(proxy, NewSection);
+	}
+	else if (proxy != nullptr)
+	{
+		ENQUEUE_RENDER_COMMAND(FComponentUpdate)([proxy, NewSection](FRHICommandListImmediate& RHICmdList) {
+			proxy->UpdateMap(NewSection);
+			});
+	}
 	MarkRenderTransformDirty();
 }
 
-void UTerrainComponent::UpdateCollision()
+void UTerrainComponent::UpdateCollisionVertices()
+{
+	// Move the vertices of the live collision body if the map data has changed
+	if (!MapProxy.IsValid())
+	{
+		return;
+	}
+
+	uint32 hash = MapProxy->GetHash();
+	if (hash != LiveHash)
+	{
+		TArray<FVector> vertices;
+		GetVertices(vertices);
+		BodyInstance.UpdateTriMeshVertices(vertices);
+		LiveHash = hash;
+	}
+}
+
+void UTerrainComponent::UpdateCollision(bool ForceSync)
 {
 	SCOPE_CYCLE_COUNTER(STAT_DynamicTerrain_RebuildCollision);
 
-	if (AsyncCooking)
+	// Key the collision body to the map data it is cooked from
+	CookedHash = MapProxy.IsValid() ? MapProxy->GetHash() : 0;
+	LiveHash = CookedHash;
+
+	if (AsyncCooking && !ForceSync)
 	{
 		// Abort previous cooks
 		for (UBodySetup* body : BodySetupQueue)
@@ -231,11 +331,15 @@ void UTerrainComponent::UpdateCollision()
 	else
 	{
 		// Create a new body setup and clean out the async queue
+		for (UBodySetup* body : BodySetupQueue)
+		{
+			body->AbortPhysicsMeshAsyncCreation();
+		}
 		BodySetupQueue.Empty();
 		GetBodySetup();
 
 		// Change GUID for new collision data
-		BodySetup->BodySetupGuid = FGuid::NewGuid();
+		BodySetup->BodySetupGuid = GetCollisionGuid();
 
 		// Cook collision data
 		BodySetup->bHasCookedCollisionData = true;
@@ -270,8 +374,9 @@ void UTerrainComponent::FinishCollision(bool Success, UBodySetup* NewBodySetup)
 		}
 		else
 		{
-			// Remove failed bake
+			// Remove failed bake and make sure collision is recooked before saving
 			BodySetupQueue.RemoveAt(location);
+			CookedHash = 0;
 		}
 	}
 }
@@ -279,7 +384,7 @@ void UTerrainComponent::FinishCollision(bool Success, UBodySetup* NewBodySetup)
 UBodySetup* UTerrainComponent::CreateBodySetup()
 {
 	UBodySetup* newbody = NewObject<UBodySetup>(this, NAME_None, IsTemplate() ? RF_Public : RF_NoFlags);
-	newbody->BodySetupGuid = FGuid::NewGuid();
+	newbody->BodySetupGuid = GetCollisionGuid();
 
 	newbody->bGenerateMirroredCollision = false;
 	newbody->bDoubleSidedGeometry = true;
@@ -288,6 +393,13 @@ UBodySetup* UTerrainComponent::CreateBodySetup()
 	return newbody;
 }
 
+FGuid UTerrainComponent::GetCollisionGuid() const
+{
+	// Sections with identical map data produce identical collision, so they can share derived data
+	// The key is a cryptographic hash of the data, so a section is never given another section's collision
+	return MapProxy.IsValid() ? MapProxy->GetGuid() : FGuid::NewGuid();
+}
+
 TSharedPtr<FMapSection, ESPMode::ThreadSafe> UTerrainComponent::GetMapProxy()
 {
 	VerifyMapProxy();
@@ -297,24 +409,76 @@ TSharedPtr<FMapSection, ESPMode::ThreadSafe> UTerrainComponent::GetMapProxy()
 void UTerrainComponent::SetMapProxy(TSharedPtr<FMapSection, ESPMode::ThreadSafe> Proxy)
 {
 	MapProxy = Proxy;
+	UpdateHeightRange();
+	UpdateBounds();
 	MarkRenderStateDirty();
 }
 
+void UTerrainComponent::SetLODGrid(TSharedPtr<FTerrainLODGrid, ESPMode::ThreadSafe> Grid)
+{
+	if (LODGrid != Grid)
+	{
+		LODGrid = Grid;
+		MarkRenderStateDirty();
+	}
+}
+
+void UTerrainComponent::SetUploadQueue(TSharedPtr<FTerrainUploadQueue, ESPMode::ThreadSafe> Queue)
+{
+	UploadQueue = Queue;
+}
+
+void UTerrainComponent::FinalizeCollision()
+{
+	if (!IsCollisionCurrent())
+	{
+		UpdateCollision(true);
+	}
+}
+
+bool UTerrainComponent::IsCollisionCurrent() const
+{
+	return BodySetup != nullptr && BodySetupQueue.Num() == 0 && MapProxy.IsValid() && MapProxy->GetHash() == CookedHash;
+}
+
 void UTerrainComponent::VerifyMapProxy()
 {
 	uint32 width = GetTerrainComponentWidth(Size) + 2;
-	if (!MapProxy.IsValid())
+	if (Size > 1 && (!MapProxy.IsValid() || MapProxy->X != width || MapProxy->Y != width))
 	{
-		if (Size > 1)
+		MapProxy = MakeShareable(new FMapSection(width, width));
+
+		// Copy the section from the parent terrain's heightmap if it is available
+		ATerrain* terrain = Cast<ATerrain>(GetOwner());
+		if (terrain != nullptr && terrain->GetMap() != nullptr)
 		{
-			MapProxy = MakeShareable(new FMapSection(width, width));
+			FIntPoint min(XOffset * (width - 3), YOffset * (width - 3));
+			terrain->GetMap()->GetMapSection(MapProxy.Get(), min);
 		}
+		UpdateHeightRange();
 	}
-	else
+}
+
+void UTerrainComponent::UpdateHeightRange()
+{
+	uint32 width = GetTerrainComponentWidth(Size);
+	if (!MapProxy.IsValid() || MapProxy->X != width + 2 || MapProxy->Y != width + 2)
 	{
-		if (MapProxy->X != width || MapProxy->Y != width)
+		return;
+	}
+
+	// Find the range of heights covered by the component's vertices, ignoring the border
+	float min_height = MAX_flt;
+	float max_height = -MAX_flt;
+	for (uint32 y = 1; y <= width; ++y)
+	{
+		const float* row = &MapProxy->Data[y * MapProxy->X + 1];
+		for (uint32 x = 0; x < width; ++x)
 		{
-			MapProxy = MakeShareable(new FMapSection(width, width));
+			min_height = FMath::Min(min_height, row[x]);
+			max_height = FMath::Max(max_height, row[x]);
 		}
 	}
+	MinHeight = min_height;
+	MaxHeight = max_height;
 }
\ No newline at end of file
@@ -0,0 +1,351 @@
+#include "TerrainErosion.h"
+#include "TerrainStat.h"
+
+#include "Async/ParallelFor.h"
+#include "Math/VectorRegister.h"
+
+DECLARE_CYCLE_STAT(TEXT("Dynamic Terrain - Hydraulic Erosion"), STAT_DynamicTerrain_HydraulicErosion, STATGROUP_DynamicTerrain);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dynamic Terrain - Erosion Droplets"), STAT_DynamicTerrain_ErosionDroplets, STATGROUP_DynamicTerrain);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Dynamic Terrain - Erosion Droplets per Second"), STAT_DynamicTerrain_ErosionThroughput, STATGROUP_DynamicTerrain);
+DECLARE_CYCLE_STAT(TEXT("Dynamic Terrain - Thermal Erosion"), STAT_DynamicTerrain_ThermalErosion, STATGROUP_DynamicTerrain);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dynamic Terrain - Thermal Erosion Samples"), STAT_DynamicTerrain_ThermalSamples, STATGROUP_DynamicTerrain);
+
+// The smallest width of an erosion tile, smaller tiles have too few droplets to be worth a task
+constexpr int32 erosion_min_tile = 64;
+// The number of times each colour of tiles is run, so that no colour always erodes after the others
+constexpr int32 erosion_rounds = 4;
+// The number of rows relaxed by each parallel task
+constexpr int32 thermal_band_rows = 32;
+// Regions with fewer samples are relaxed on the calling thread, where task overhead would outweigh the work
+constexpr int32 thermal_parallel_samples = 128 * 128;
+// Each sample exchanges with four neighbours, moving more than an eighth of each difference could overshoot and oscillate
+// Both samples of a pair move, so full strength removes a quarter of the excess between them per iteration
+constexpr float thermal_stable_rate = 0.125f;
+
+/// Hydraulic Erosion ///
+
+FHydraulicErosion::FHydraulicErosion(const FHydraulicErosionSettings& NewSettings)
+	: Settings(NewSettings)
+{
+	Settings.MaxLifetime = FMath::Max(Settings.MaxLifetime, 1);
+	Settings.Radius = FMath::Max(Settings.Radius, 1);
+	Settings.Inertia = FMath::Clamp(Settings.Inertia, 0.0f, 1.0f);
+	Settings.EvaporateSpeed = FMath::Clamp(Settings.EvaporateSpeed, 0.0f, 1.0f);
+
+	// Weight the samples around a droplet by their distance from it
+	float total = 0.0f;
+	for (int32 y = -Settings.Radius; y <= Settings.Radius; ++y)
+	{
+		for (int32 x = -Settings.Radius; x <= Settings.Radius; ++x)
+		{
+			float weight = Settings.Radius - FMath::Sqrt((float)(x * x + y * y));
+			if (weight > 0.0f)
+			{
+				BrushOffsets.Add(FIntPoint(x, y));
+				BrushWeights.Add(weight);
+				total += weight;
+			}
+		}
+	}
+
+	for (float& weight : BrushWeights)
+	{
+		weight /= total;
+	}
+}
+
+int32 FHydraulicErosion::GetReach() const
+{
+	// A droplet moves one sample per step, erodes within its radius and deposits on the next sample over
+	return Settings.MaxLifetime + Settings.Radius + 2;
+}
+
+void FHydraulicErosion::Erode(float* Heights, int32 WidthX, int32 WidthY) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_DynamicTerrain_HydraulicErosion);
+
+	if (Settings.Droplets <= 0 || WidthX < 2 || WidthY < 2)
+	{
+		return;
+	}
+
+	// Tiles of the same colour are separated by a tile of another colour, which must be wider than the reach of two droplets
+	int32 tile_size = FMath::Max(erosion_min_tile, GetReach() * 2);
+	int32 tiles_x = FMath::DivideAndRoundUp(WidthX, tile_size);
+	int32 tiles_y = FMath::DivideAndRoundUp(WidthY, tile_size);
+
+	// Group the tiles by colour
+	TArray<FIntPoint> colours[4];
+	for (int32 y = 0; y < tiles_y; ++y)
+	{
+		for (int32 x = 0; x < tiles_x; ++x)
+		{
+			colours[(x & 1) + (y & 1) * 2].Add(FIntPoint(x, y));
+		}
+	}
+
+	// Droplets start in the area where the map can be interpolated
+	int64 total_area = (int64)(WidthX - 1) * (WidthY - 1);
+
+	double start_time = FPlatformTime::Seconds();
+	for (int32 round = 0; round < erosion_rounds; ++round)
+	{
+		for (const TArray<FIntPoint>& colour : colours)
+		{
+			ParallelFor(colour.Num(), [&](int32 Index) {
+				FIntPoint tile = colour[Index];
+				FIntRect rect(tile * tile_size, FIntPoint(tile.X + 1, tile.Y + 1) * tile_size);
+				rect.Max.X = FMath::Min(rect.Max.X, WidthX - 1);
+				rect.Max.Y = FMath::Min(rect.Max.Y, WidthY - 1);
+				if (rect.Area() <= 0)
+				{
+					return;
+				}
+
+				// Share the droplets by area, splitting each tile's droplets evenly between the rounds
+				int64 tile_droplets = (int64)Settings.Droplets * rect.Area() / total_area;
+				int32 num_droplets = (int32)(tile_droplets * (round + 1) / erosion_rounds - tile_droplets * round / erosion_rounds);
+
+				// Each tile and round draws from its own stream
+				uint32 tile_index = (tile.Y * tiles_x + tile.X) * erosion_rounds + round;
+				ErodeTile(Heights, WidthX, WidthY, rect, num_droplets, FTerrainRandom((uint32)Settings.Seed, tile_index));
+				});
+		}
+	}
+	double elapsed = FPlatformTime::Seconds() - start_time;
+
+	INC_DWORD_STAT_BY(STAT_DynamicTerrain_ErosionDroplets, Settings.Droplets);
+	if (elapsed > 0.0)
+	{
+		SET_FLOAT_STAT(STAT_DynamicTerrain_ErosionThroughput, Settings.Droplets / elapsed);
+	}
+}
+
+void FHydraulicErosion::ErodeTile(float* Heights, int32 WidthX, int32 WidthY, FIntRect Tile, int32 NumDroplets, const FTerrainRandom& Random) const
+{
+	for (int32 i = 0; i < NumDroplets; ++i)
+	{
+		float x = Random.GetRange(i * 2, (float)Tile.Min.X, (float)Tile.Max.X);
+		float y = Random.GetRange(i * 2 + 1, (float)Tile.Min.Y, (float)Tile.Max.Y);
+		SimulateDroplet(Heights, WidthX, WidthY, FVector2D(x, y));
+	}
+}
+
+void FHydraulicErosion::SimulateDroplet(float* Heights, int32 WidthX, int32 WidthY, FVector2D Position) const
+{
+	// Rounding can place a droplet on the far edge of the map
+	if (Position.X >= WidthX - 1 || Position.Y >= WidthY - 1)
+	{
+		return;
+	}
+
+	FVector2D direction = FVector2D::ZeroVector;
+	float speed = 1.0f;
+	float water = 1.0f;
+	float sediment = 0.0f;
+
+	for (int32 life = 0; life < Settings.MaxLifetime; ++life)
+	{
+		int32 x = FMath::FloorToInt(Position.X);
+		int32 y = FMath::FloorToInt(Position.Y);
+		float u = Position.X - x;
+		float v = Position.Y - y;
+
+		// Turn the droplet downhill, keeping some of its previous direction
+		FVector2D gradient;
+		float height = GetHeightAndGradient(Heights, WidthX, Position, gradient);
+		direction = direction * Settings.Inertia - gradient * (1.0f - Settings.Inertia);
+		float length = direction.Size();
+		if (length <= KINDA_SMALL_NUMBER)
+		{
+			break;
+		}
+		direction /= length;
+
+		// Stop once the droplet leaves the interpolated area of the map
+		Position += direction;
+		if (Position.X < 0.0f || Position.Y < 0.0f || Position.X >= WidthX - 1 || Position.Y >= WidthY - 1)
+		{
+			break;
+		}
+
+		FVector2D next_gradient;
+		float delta = GetHeightAndGradient(Heights, WidthX, Position, next_gradient) - height;
+
+		// Faster droplets with more water can carry more sediment down steeper slopes
+		float capacity = FMath::Max(-delta * speed * water * Settings.SedimentCapacity, Settings.MinSedimentCapacity);
+		if (sediment > capacity || delta > 0.0f)
+		{
+			// Fill the pit when going uphill, otherwise drop part of the excess sediment
+			float deposit = delta > 0.0f ? FMath::Min(delta, sediment) : (sediment - capacity) * Settings.DepositSpeed;
+			sediment -= deposit;
+
+			// Deposit on the corners of the cell the droplet left
+			float* cell = Heights + y * WidthX + x;
+			cell[0] += deposit * (1.0f - u) * (1.0f - v);
+			cell[1] += deposit * u * (1.0f - v);
+			cell[WidthX] += deposit * (1.0f - u) * v;
+			cell[WidthX + 1] += deposit * u * v;
+		}
+		else
+		{
+			// Erode no more than the height difference so the droplet does not dig a pit behind it
+			float erode = FMath::Min((capacity - sediment) * Settings.ErodeSpeed, -delta);
+			for (int32 i = 0; i < BrushOffsets.Num(); ++i)
+			{
+				int32 brush_x = x + BrushOffsets[i].X;
+				int32 brush_y = y + BrushOffsets[i].Y;
+				if (brush_x >= 0 && brush_y >= 0 && brush_x < WidthX && brush_y < WidthY)
+				{
+					float amount = erode * BrushWeights[i];
+					Heights[brush_y * WidthX + brush_x] -= amount;
+					sediment += amount;
+				}
+			}
+		}
+
+		speed = FMath::Sqrt(FMath::Max(speed * speed - delta * Settings.Gravity, 0.0f));
+		water *= 1.0f - Settings.EvaporateSpeed;
+	}
+}
+
+float FHydraulicErosion::GetHeightAndGradient(const float* Heights, int32 WidthX, FVector2D Position, FVector2D& OutGradient) const
+{
+	int32 x = FMath::FloorToInt(Position.X);
+	int32 y = FMath::FloorToInt(Position.Y);
+	float u = Position.X - x;
+	float v = Position.Y - y;
+
+	const float* cell = Heights + y * WidthX + x;
+	float h00 = cell[0];
+	float h10 = cell[1];
+	float h01 = cell[WidthX];
+	float h11 = cell[WidthX + 1];
+
+	OutGradient.X = (h10 - h00) * (1.0f - v) + (h11 - h01) * v;
+	OutGradient.Y = (h01 - h00) * (1.0f - u) + (h11 - h10) * u;
+
+	return h00 * (1.0f - u) * (1.0f - v) + h10 * u * (1.0f - v) + h01 * (1.0f - u) * v + h11 * u * v;
+}
+
+/// Thermal Erosion ///
+
+FThermalErosion::FThermalErosion(const FThermalErosionSettings& NewSettings)
+	: Settings(NewSettings)
+{
+	Settings.Talus = FMath::Max(Settings.Talus, 0.0f);
+	Rate = FMath::Clamp(Settings.Strength, 0.0f, 1.0f) * thermal_stable_rate;
+}
+
+void FThermalErosion::Erode(float* Heights, int32 WidthX, int32 WidthY, FIntRect Range) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_DynamicTerrain_ThermalErosion);
+
+	Range.Clip(FIntRect(0, 0, WidthX, WidthY));
+	int32 width = Range.Width();
+	int32 height = Range.Height();
+	if (width < 1 || height < 1 || Settings.Iterations < 1 || Rate <= 0.0f)
+	{
+		return;
+	}
+
+	// Copy the region into the first buffer, iterations alternate between reading one buffer and writing the other
+	TArray<float> buffers[2];
+	buffers[0].SetNumUninitialized(width * height);
+	buffers[1].SetNumUninitialized(width * height);
+	for (int32 y = 0; y < height; ++y)
+	{
+		FMemory::Memcpy(buffers[0].GetData() + y * width, Heights + (Range.Min.Y + y) * WidthX + Range.Min.X, width * sizeof(float));
+	}
+
+	int32 num_bands = FMath::DivideAndRoundUp(height, thermal_band_rows);
+	bool single_thread = width * height < thermal_parallel_samples;
+	int32 current = 0;
+	for (int32 i = 0; i < Settings.Iterations; ++i)
+	{
+		const float* source = buffers[current].GetData();
+		float* dest = buffers[current ^ 1].GetData();
+		ParallelFor(num_bands, [&](int32 Band) {
+			int32 end = FMath::Min(height, (Band + 1) * thermal_band_rows);
+			for (int32 y = Band * thermal_band_rows; y < end; ++y)
+			{
+				RelaxRow(source, dest, width, height, y);
+			}
+			}, single_thread);
+		current ^= 1;
+	}
+
+	for (int32 y = 0; y < height; ++y)
+	{
+		FMemory::Memcpy(Heights + (Range.Min.Y + y) * WidthX + Range.Min.X, buffers[current].GetData() + y * width, width * sizeof(float));
+	}
+
+	INC_DWORD_STAT_BY(STAT_DynamicTerrain_ThermalSamples, width * height * Settings.Iterations);
+}
+
+void FThermalErosion::RelaxRow(const float* Source, float* Dest, int32 Width, int32 Height, int32 Y) const
+{
+	const float* row = Source + Y * Width;
+	const float* up = Y > 0 ? row - Width : nullptr;
+	const float* down = Y < Height - 1 ? row + Width : nullptr;
+	float* out = Dest + Y * Width;
+
+	// The part of a height difference beyond the talus, d - clamp(d, -talus, talus)
+	float talus = Settings.Talus;
+	auto relax_sample = [&](int32 X) {
+		float center = row[X];
+		float flow = 0.0f;
+		if (X > 0)
+		{
+			float d = row[X - 1] - center;
+			flow += d - FMath::Clamp(d, -talus, talus);
+		}
+		if (X < Width - 1)
+		{
+			float d = row[X + 1] - center;
+			flow += d - FMath::Clamp(d, -talus, talus);
+		}
+		if (up)
+		{
+			float d = up[X] - center;
+			flow += d - FMath::Clamp(d, -talus, talus);
+		}
+		if (down)
+		{
+			float d = down[X] - center;
+			flow += d - FMath::Clamp(d, -talus, talus);
+		}
+		out[X] = center + flow * Rate;
+	};
+
+	relax_sample(0);
+	int32 x = 1;
+
+	// Samples with all four neighbours are relaxed four at a time
+	if (up && down)
+	{
+		const VectorRegister max_difference = VectorSetFloat1(talus);
+		const VectorRegister min_difference = VectorSetFloat1(-talus);
+		const VectorRegister rate = VectorSetFloat1(Rate);
+		for (; x + 4 <= Width - 1; x += 4)
+		{
+			VectorRegister center = VectorLoad(row + x);
+			VectorRegister left = VectorSubtract(VectorLoad(row + x - 1), center);
+			VectorRegister right = VectorSubtract(VectorLoad(row + x + 1), center);
+			VectorRegister above = VectorSubtract(VectorLoad(up + x), center);
+			VectorRegister below = VectorSubtract(VectorLoad(down + x), center);
+
+			VectorRegister flow = VectorSubtract(left, VectorMin(VectorMax(left, min_difference), max_difference));
+			flow = VectorAdd(flow, VectorSubtract(right, VectorMin(VectorMax(right, min_difference), max_difference)));
+			flow = VectorAdd(flow, VectorSubtract(above, VectorMin(VectorMax(above, min_difference), max_difference)));
+			flow = VectorAdd(flow, VectorSubtract(below, VectorMin(VectorMax(below, min_difference), max_difference)));
+
+			VectorStore(VectorMultiplyAdd(flow, rate, center), out + x);
+		}
+	}
+
+	for (; x < Width; ++x)
+	{
+		relax_sample(x);
+	}
+}
\ No newline at end of file
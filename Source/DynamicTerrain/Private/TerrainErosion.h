@@ -0,0 +1,55 @@
+#pragma once
+
+#include "TerrainHeightMap.h"
+#include "TerrainAlgorithms.h"
+
+#include "CoreMinimal.h"
+
+// Simulates water droplets running down a heightmap, eroding slopes and depositing sediment where the water slows down
+// The map is split into tiles coloured in a 2x2 pattern, and tiles of one colour are far enough apart that their droplets never reach the same samples
+// Each colour is run in parallel and each tile places its droplets with its own seed, so the result does not depend on the number of threads
+class FHydraulicErosion
+{
+public:
+	FHydraulicErosion(const FHydraulicErosionSettings& NewSettings);
+
+	// Erode a heightmap of WidthX by WidthY samples in place
+	void Erode(float* Heights, int32 WidthX, int32 WidthY) const;
+
+	// Get the distance from its starting point at which a droplet can change the map
+	int32 GetReach() const;
+
+private:
+	// Run the droplets of one tile, in the order they are placed
+	void ErodeTile(float* Heights, int32 WidthX, int32 WidthY, FIntRect Tile, int32 NumDroplets, const FTerrainRandom& Random) const;
+	// Move a droplet from Position until it evaporates or leaves the map
+	void SimulateDroplet(float* Heights, int32 WidthX, int32 WidthY, FVector2D Position) const;
+	// Get the height and gradient of the map at a position by bilinear interpolation
+	float GetHeightAndGradient(const float* Heights, int32 WidthX, FVector2D Position, FVector2D& OutGradient) const;
+
+	FHydraulicErosionSettings Settings;
+
+	// The offsets and weights of the samples eroded around a droplet
+	TArray<FIntPoint> BrushOffsets;
+	TArray<float> BrushWeights;
+};
+
+// Moves material from each sample to its four neighbours wherever their height difference exceeds the talus
+// Every sample is computed from the heights of the previous iteration, so rows are independent and each one is computed four samples at a time
+// Each pair of samples exchanges the same amount in opposite directions, so the total height is preserved
+class FThermalErosion
+{
+public:
+	FThermalErosion(const FThermalErosionSettings& NewSettings);
+
+	// Erode the samples of a heightmap of WidthX by WidthY samples that are inside Range, in place
+	void Erode(float* Heights, int32 WidthX, int32 WidthY, FIntRect Range) const;
+
+private:
+	// Compute one row of the next iteration, Source and Dest hold Width by Height samples
+	void RelaxRow(const float* Source, float* Dest, int32 Width, int32 Height, int32 Y) const;
+
+	FThermalErosionSettings Settings;
+	// The fraction of the excess height difference moved to each neighbour per iteration
+	float Rate;
+};
\ No newline at end of file
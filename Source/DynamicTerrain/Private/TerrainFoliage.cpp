@@ -5,9 +5,6 @@
 #include "Components/HierarchicalInstancedStaticMeshComponent.h"
 #include "Kismet/KismetMathLibrary.h"
 
-#include <random>
-#include <limits>
-
 void UTerrainFoliageSpawner::AddFoliageCluster(ATerrain* Terrain, FVector Location, uint32 Seed) const
 {
 	// Get the bounds of the map
@@ -18,11 +15,9 @@ void UTerrainFoliageSpawner::AddFoliageCluster(ATerrain* Terrain, FVector Locati
 	FVector2D min(center.X - xbounds, center.Y - ybounds);
 	FVector2D max(center.X + xbounds, center.Y + ybounds);
 
-	// Get a cluster of points
-	std::default_random_engine rando(Seed);
-	std::uniform_int_distribution<uint32> random_seed(0, std::numeric_limits<uint32>::max());
-	std::uniform_int_distribution<uint32> cluster(ClusterMin, ClusterMax);
-	PointNoise noise(Radius, cluster(rando), random_seed(rando));
+	// Get a cluster of points, the meshes are picked with the indices after the cluster's size and seed
+	FTerrainRandom random(Seed);
+	PointNoise noise(Radius, random.GetInt(0, (int32)ClusterMin, (int32)ClusterMax), random.GetUInt(1));
 
 	// Add meshes at each point generated
 	const TArray<FVector2D>& points = noise.GetPoints();
@@ -43,7 +38,7 @@ void UTerrainFoliageSpawner::AddFoliageCluster(ATerrain* Terrain, FVector Locati
 			// Pick a new mesh
 			if (!MatchClusters || foliage == nullptr )
 			{
-				foliage = GetRandomFoliage(random_seed(rando));
+				foliage = GetRandomFoliage(random.GetUInt(i + 2));
 			}
 
 			// Set the rotation to match the terrain normal
@@ -57,7 +52,10 @@ void UTerrainFoliageSpawner::AddFoliageCluster(ATerrain* Terrain, FVector Locati
 			FTransform transform;
 			transform.SetLocation(location);
 			transform.SetRotation(rotation.Quaternion());
-			Terrain->FindInstancedMesh(foliage->Mesh)->AddInstance(transform);
+			if (UHierarchicalInstancedStaticMeshComponent* component = Terrain->FindInstancedMesh(foliage->Mesh, location))
+			{
+				component->AddInstance(transform);
+			}
 		}
 	}
 }
@@ -83,7 +81,10 @@ void UTerrainFoliageSpawner::AddFoliageUnit(ATerrain* Terrain, FVector Location,
 		FTransform transform;
 		transform.SetLocation(location);
 		transform.SetRotation(rotation.Quaternion());
-		Terrain->FindInstancedMesh(foliage->Mesh)->AddInstance(transform);
+		if (UHierarchicalInstancedStaticMeshComponent* component = Terrain->FindInstancedMesh(foliage->Mesh, location))
+		{
+			component->AddInstance(transform);
+		}
 	}
 }
 
@@ -99,9 +100,7 @@ UTerrainFoliage* UTerrainFoliageSpawner::GetRandomFoliage(uint32 Seed) const
 	if (total_weight > 0)
 	{
 		// Get a random index value
-		std::default_random_engine rando(Seed);
-		std::uniform_int_distribution<int32> dist(1, total_weight);
-		int32 n = dist(rando);
+		int32 n = FTerrainRandom(Seed).GetInt(0, 1, total_weight);
 
 		// Find which component corresponds to the random index
 		UStaticMesh* mesh = nullptr;
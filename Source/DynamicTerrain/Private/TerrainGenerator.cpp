@@ -1,12 +1,197 @@
 #include "TerrainGenerator.h"
 #include "Terrain.h"
 #include "TerrainAlgorithms.h"
+#include "TerrainGraph.h"
+#include "TerrainStat.h"
 
 #include "Kismet/KismetMathLibrary.h"
+#include "Async/ParallelFor.h"
+#include "Async/TaskGraphInterfaces.h"
+#include "UObject/GCObject.h"
 
 #include <chrono>
-#include <random>
-#include <limits>
+
+DECLARE_CYCLE_STAT(TEXT("Dynamic Terrain - Generate Map"), STAT_DynamicTerrain_GenerateMap, STATGROUP_DynamicTerrain);
+
+// The number of heightmap rows sampled by each parallel task
+constexpr int32 generator_band_rows = 32;
+
+// The random streams drawn by each generator step, so that steps get independent values from one seed whatever order they run in
+enum class EGeneratorStream : uint32
+{
+	Perlin = 1,
+	TestGenerator,
+	Mountains,
+	Erosion,
+	FoliageRandom,
+	FoliageUniform
+};
+
+// Sample every row of the heightmap in parallel bands, each band writes a contiguous block of the map
+// SampleRow is called as SampleRow(Y, Heights) from multiple threads to fill a row of GetWidthX heights, so it may only read shared data
+// Each band is reported to Task when generating in the background, and bands are skipped once it is cancelled
+template<typename SampleFunction>
+static void GenerateRows(UHeightMap* Map, FTerrainGenerationTask* Task, SampleFunction SampleRow)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DynamicTerrain_GenerateMap);
+
+	int32 width_x = Map->GetWidthX();
+	int32 width_y = Map->GetWidthY();
+	int32 num_bands = FMath::DivideAndRoundUp(width_y, generator_band_rows);
+	if (Task)
+	{
+		Task->AddWork(num_bands);
+	}
+
+	ParallelFor(num_bands, [&](int32 Band) {
+		if (Task && Task->IsCancelled())
+		{
+			return;
+		}
+
+		TArray<float> heights;
+		heights.SetNumUninitialized(width_x);
+
+		int32 end = FMath::Min(width_y, (Band + 1) * generator_band_rows);
+		for (int32 y = Band * generator_band_rows; y < end; ++y)
+		{
+			SampleRow(y, heights.GetData());
+			for (int32 x = 0; x < width_x; ++x)
+			{
+				Map->SetHeight(x, y, heights[x]);
+			}
+		}
+
+		if (Task)
+		{
+			Task->CompleteWork(1);
+		}
+		});
+}
+
+// Keeps a generator and its staging map alive while a worker generates, without holding off garbage collection
+class FTerrainGenerationReferences : public FGCObject
+{
+public:
+	FTerrainGenerationReferences(UMapGenerator* NewGenerator)
+		: Generator(NewGenerator)
+	{
+	}
+
+	virtual void AddReferencedObjects(FReferenceCollector& Collector) override
+	{
+		Collector.AddReferencedObject(Generator);
+	}
+
+	virtual FString GetReferencerName() const override
+	{
+		return TEXT("FTerrainGenerationReferences");
+	}
+
+	UMapGenerator* Generator;
+};
+
+// The arguments of a call to a generator function, filled on the game thread and used by the worker
+class FGeneratorCall
+{
+public:
+	FGeneratorCall(UFunction* NewFunction)
+		: Function(NewFunction)
+	{
+		Parameters = (uint8*)FMemory::Malloc(FMath::Max<int32>(Function->ParmsSize, 1), Function->GetMinAlignment());
+		FMemory::Memzero(Parameters, Function->ParmsSize);
+		for (TFieldIterator<FProperty> it(Function); it && it->HasAnyPropertyFlags(CPF_Parm); ++it)
+		{
+			it->InitializeValue_InContainer(Parameters);
+		}
+	}
+
+	~FGeneratorCall()
+	{
+		for (TFieldIterator<FProperty> it(Function); it && it->HasAnyPropertyFlags(CPF_Parm); ++it)
+		{
+			it->DestroyValue_InContainer(Parameters);
+		}
+		FMemory::Free(Parameters);
+	}
+
+	UFunction* Function;
+	uint8* Parameters;
+};
+
+// Parse a command, the name of a generator function followed by its arguments, into a call to the generator
+// The function is looked up and its parameters are filled on the game thread, the worker only calls it
+// Any function declared by the generator with only numeric parameters is a command, the same functions the editor lists
+// An empty function is returned for invalid commands
+static TFunction<void()> bind_generator_command(UMapGenerator* Generator, const FString& Command)
+{
+	TArray<FString> tokens;
+	Command.ParseIntoArrayWS(tokens);
+	if (tokens.Num() == 0)
+	{
+		return TFunction<void()>();
+	}
+
+	UFunction* function = UMapGenerator::StaticClass()->FindFunctionByName(FName(*tokens[0], FNAME_Find), EIncludeSuperFlag::ExcludeSuper);
+	if (function == nullptr)
+	{
+		return TFunction<void()>();
+	}
+
+	// Each parameter takes the next argument
+	TSharedRef<FGeneratorCall, ESPMode::ThreadSafe> call = MakeShared<FGeneratorCall, ESPMode::ThreadSafe>(function);
+	int32 argument = 1;
+	for (TFieldIterator<FProperty> it(function); it && it->HasAnyPropertyFlags(CPF_Parm); ++it)
+	{
+		FNumericProperty* numeric = CastField<FNumericProperty>(*it);
+		if (numeric == nullptr || numeric->HasAnyPropertyFlags(CPF_ReturnParm) || argument >= tokens.Num())
+		{
+			return TFunction<void()>();
+		}
+		numeric->SetNumericPropertyValueFromString(numeric->ContainerPtrToValuePtr<void>(call->Parameters), *tokens[argument++]);
+	}
+	if (argument != tokens.Num())
+	{
+		return TFunction<void()>();
+	}
+
+	return [Generator, call]() {
+		Generator->ProcessEvent(call->Function, call->Parameters);
+	};
+}
+
+/// Generation Task ///
+
+float FTerrainGenerationTask::GetProgress() const
+{
+	int32 total = TotalWork.GetValue();
+	return total > 0 ? FMath::Clamp((float)CompletedWork.GetValue() / total, 0.0f, 1.0f) : 0.0f;
+}
+
+bool FTerrainGenerationTask::IsComplete() const
+{
+	return Complete;
+}
+
+bool FTerrainGenerationTask::IsCancelled() const
+{
+	return Cancelled;
+}
+
+void FTerrainGenerationTask::Cancel()
+{
+	Cancelled = true;
+}
+
+void FTerrainGenerationTask::AddWork(int32 Units)
+{
+	TotalWork.Add(Units);
+}
+
+void FTerrainGenerationTask::CompleteWork(int32 Units)
+{
+	CompletedWork.Add(Units);
+}
 
 /// Map Generator Functions ///
 
@@ -20,8 +205,79 @@ void UMapGenerator::SetSeed(int32 NewSeed)
 	Seed = (uint32)NewSeed;
 }
 
+UHeightMap* UMapGenerator::GetMap() const
+{
+	return CurrentTask.IsValid() ? StagingMap : Terrain->GetMap();
+}
+
+/// Background Generation ///
+
+FTerrainGenerationTaskRef UMapGenerator::GenerateAsync(TFunction<void()> Generator, TFunction<void(bool)> OnComplete)
+{
+	if (CurrentTask.IsValid())
+	{
+		return CurrentTask.ToSharedRef();
+	}
+
+	FTerrainGenerationTaskRef task = MakeShared<FTerrainGenerationTask, ESPMode::ThreadSafe>();
+	if (Terrain == nullptr || !Generator)
+	{
+		task->Cancelled = true;
+		task->Complete = true;
+		return task;
+	}
+
+	// Generate into a copy so the terrain can still be drawn and edited while the worker runs
+	if (StagingMap == nullptr)
+	{
+		StagingMap = NewObject<UHeightMap>(this);
+	}
+	StagingMap->CopyMap(Terrain->GetMap());
+	CurrentTask = task;
+	CompleteCallback = OnComplete;
+
+	// The worker only uses the generator and the staging map, which are referenced until the generation finishes
+	TSharedRef<FTerrainGenerationReferences> references = MakeShared<FTerrainGenerationReferences>(this);
+	GenerateEvent = FFunctionGraphTask::CreateAndDispatchWhenReady([Generator]() {
+		Generator();
+		}, TStatId(), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
+
+	FGraphEventArray prerequisites;
+	prerequisites.Add(GenerateEvent);
+	TWeakObjectPtr<ATerrain> target = Terrain;
+	FFunctionGraphTask::CreateAndDispatchWhenReady([references, target]() {
+		if (references->Generator != nullptr)
+		{
+			references->Generator->FinishGeneration(target);
+		}
+		}, TStatId(), &prerequisites, ENamedThreads::GameThread);
+
+	return task;
+}
+
+FTerrainGenerationTaskRef UMapGenerator::GenerateCommandAsync(const FString& Command, TFunction<void(bool)> OnComplete)
+{
+	return GenerateAsync(bind_generator_command(this, Command), OnComplete);
+}
+
+bool UMapGenerator::IsGenerating() const
+{
+	return CurrentTask.IsValid();
+}
+
+bool UMapGenerator::CanGenerate() const
+{
+	// Calls on the game thread during a background generation would write the staging map alongside the worker
+	return !IsGenerating() || !IsInGameThread();
+}
+
 void UMapGenerator::Flat(float Height)
 {
+	if (!CanGenerate())
+	{
+		return;
+	}
+
 	MapFlat(0.0f);
 
 	// Noise unit test
@@ -55,71 +311,218 @@ void UMapGenerator::Flat(float Height)
 
 void UMapGenerator::Plasma(int32 Scale, int32 Foliage, float MaxHeight)
 {
+	if (!CanGenerate())
+	{
+		return;
+	}
+
 	MapPlasma(Scale, MaxHeight);
 	FoliageUniform(Foliage, Foliage);
 }
 
 void UMapGenerator::Perlin(int32 Frequency, int32 Octaves, float Persistence, float MaxHeight)
 {
+	if (!CanGenerate())
+	{
+		return;
+	}
+
+	MapPerlin(Frequency, Octaves, Persistence, MaxHeight);
+	FoliageRandom(Frequency * 10);
+}
+
+void UMapGenerator::ErodedPerlin(int32 Frequency, int32 Octaves, float Persistence, float MaxHeight, int32 Droplets)
+{
+	if (!CanGenerate())
+	{
+		return;
+	}
+
 	MapPerlin(Frequency, Octaves, Persistence, MaxHeight);
+	ErodeHydraulic(Droplets);
 	FoliageRandom(Frequency * 10);
 }
 
 void UMapGenerator::TestGenerator(int32 BaseFrequency, int32 ElevationFrequency, int32 DetailFrequency, float MaxHeight)
 {
+	if (!CanGenerate())
+	{
+		return;
+	}
+
 	if (MaxHeight < 1.0f)
 	{
 		MaxHeight = 1.0f;
 	}
 
-	std::default_random_engine rng(Seed);
-	std::uniform_int_distribution<uint32> random_seed(0, std::numeric_limits<uint32>::max());
+	FTerrainRandom random(Seed, (uint32)EGeneratorStream::TestGenerator);
 
-	UHeightMap* Map = Terrain->GetMap();
+	UHeightMap* Map = GetMap();
 
 	int32 width_x = Map->GetWidthX();
 	int32 width_y = Map->GetWidthY();
 
 	// Create noise data
-	GradientNoise base(BaseFrequency, BaseFrequency, random_seed(rng));
-	GradientNoise elevation(ElevationFrequency, ElevationFrequency, random_seed(rng));
-	GradientNoise detail(DetailFrequency, DetailFrequency, random_seed(rng));
+	GradientNoise base(BaseFrequency, BaseFrequency, random.GetUInt(0));
+	GradientNoise elevation(ElevationFrequency, ElevationFrequency, random.GetUInt(1));
+	GradientNoise detail(DetailFrequency, DetailFrequency, random.GetUInt(2));
 	base.Scale(width_x, width_y);
 	elevation.Scale(width_x, width_y);
 	detail.Scale(width_x, width_y);
 
 	// Sample the noise onto the terrain
-	for (int32 x = 0; x < width_x; ++x)
-	{
-		for (int32 y = 0; y < width_y; ++y)
+	GenerateRows(Map, CurrentTask.Get(), [&](int32 y, float* heights) {
+		TArray<float> mountains;
+		TArray<float> details;
+		mountains.SetNumUninitialized(width_x);
+		details.SetNumUninitialized(width_x);
+		base.PerlinRow(y, 0.0f, width_x, heights);
+		elevation.PerlinRow(y, 0.0f, width_x, mountains.GetData());
+		detail.PerlinRow(y, 0.0f, width_x, details.GetData());
+
+		for (int32 x = 0; x < width_x; ++x)
 		{
-			float base_height = base.Perlin(x, y);
-			float mountain = elevation.Perlin(x, y);
+			float mountain = mountains[x];
 
 			// Start with base islands
-			float height = base.Perlin(x, y) * 0.05f;
+			float height = heights[x] * 0.05f;
 			// Add mountains and valleys
 			height += mountain * mountain * mountain * 0.85f;
 			// Add rough details
-			height += detail.Perlin(x, y) * mountain * 0.1f;
+			height += details[x] * mountain * 0.1f;
 
-			Map->SetHeight(x, y, height * MaxHeight);
+			heights[x] = height * MaxHeight;
 		}
+		});
+}
+
+void UMapGenerator::Mountains(int32 Wavelength, int32 Octaves, float WarpStrength, float MaxHeight)
+{
+	if (!CanGenerate())
+	{
+		return;
+	}
+
+	// Safety check for input values
+	if (Wavelength < 2)
+	{
+		Wavelength = 2;
+	}
+	if (Octaves < 1)
+	{
+		Octaves = 1;
+	}
+
+	if (!Graph.IsValid())
+	{
+		Graph = MakeShared<FTerrainGraph>();
+	}
+
+	FTerrainRandom random(Seed, (uint32)EGeneratorStream::Mountains);
+
+	// Rolling hills at a quarter of the mountains' height
+	FTerrainStageRef hills = MakeShared<FTerrainCurveStage, ESPMode::ThreadSafe>(
+		MakeShared<FTerrainFBMStage, ESPMode::ThreadSafe>(Wavelength, Octaves, 0.5f, random.GetUInt(0)),
+		TArray<FVector2D>({ FVector2D(-1.0f, 0.0f), FVector2D(1.0f, 0.25f) }));
+
+	// Ridges displaced by low frequency noise so that the ranges meander
+	FTerrainSourceStageRef ridges = MakeShared<FTerrainRidgedStage, ESPMode::ThreadSafe>(Wavelength / 2.0f, Octaves, 0.5f, random.GetUInt(1));
+	FTerrainStageRef mountains = MakeShared<FTerrainWarpStage, ESPMode::ThreadSafe>(ridges, (float)Wavelength, WarpStrength, random.GetUInt(2));
+
+	// Only raise mountains where broad noise is high
+	FTerrainStageRef ranges = MakeShared<FTerrainMaskStage, ESPMode::ThreadSafe>(
+		MakeShared<FTerrainNoiseStage, ESPMode::ThreadSafe>(Wavelength * 2.0f, random.GetUInt(3)), -0.1f, 0.3f);
+
+	if (CurrentTask.IsValid())
+	{
+		CurrentTask->AddWork(1);
+	}
+	Graph->Generate(MakeShared<FTerrainBlendStage, ESPMode::ThreadSafe>(hills, mountains, ranges, ETerrainBlendMode::Max), GetMap(), MaxHeight);
+	if (CurrentTask.IsValid())
+	{
+		CurrentTask->CompleteWork(1);
 	}
 }
 
-/// Map Generator Components ///
+/// Background Generation ///
 
-void UMapGenerator::MapFlat(float Height)
+void UMapGenerator::BeginDestroy()
 {
-	UHeightMap* Map = Terrain->GetMap();
-	for (int32 i = 0; i < Map->GetWidthX(); ++i)
+	// The completion task won't run once the generator is gone, so stop the worker and finish the task here
+	if (CurrentTask.IsValid())
 	{
-		for (int32 j = 0; j < Map->GetWidthY(); ++j)
+		CurrentTask->Cancel();
+		if (GenerateEvent.IsValid())
 		{
-			Map->SetHeight(i, j, Height);
+			FTaskGraphInterface::Get().WaitUntilTaskCompletes(GenerateEvent);
 		}
+		FinishGeneration(nullptr);
 	}
+
+	Super::BeginDestroy();
+}
+
+void UMapGenerator::FinishGeneration(TWeakObjectPtr<ATerrain> Target)
+{
+	// The task may already have been finished when the generator was destroyed
+	if (!CurrentTask.IsValid())
+	{
+		return;
+	}
+
+	TSharedPtr<FTerrainGenerationTask, ESPMode::ThreadSafe> task = CurrentTask;
+	TFunction<void(bool)> on_complete = MoveTemp(CompleteCallback);
+	TArray<TFunction<void()>> foliage = MoveTemp(DeferredFoliage);
+	CompleteCallback = nullptr;
+	DeferredFoliage.Reset();
+	CurrentTask.Reset();
+	GenerateEvent = nullptr;
+
+	// Keep the current heightmap if the generation was cancelled or the terrain was resized while it ran
+	ATerrain* terrain = Target.Get();
+	bool swapped = false;
+	if (!task->IsCancelled() && terrain != nullptr && terrain->GetMap()->GetWidthX() == StagingMap->GetWidthX() && terrain->GetMap()->GetWidthY() == StagingMap->GetWidthY())
+	{
+		// Only update the sections that changed
+		FIntRect changed = terrain->GetMap()->SwapMap(StagingMap);
+		if (changed.Area() > 0)
+		{
+			terrain->UpdateRange(changed);
+			terrain->Update();
+		}
+
+		// Replace the foliage of the old heightmap with foliage on the terrain that was generated, even if another terrain has been selected since
+		terrain->DeleteFoliage();
+		ATerrain* selected = Terrain;
+		Terrain = terrain;
+		for (TFunction<void()>& place_foliage : foliage)
+		{
+			place_foliage();
+		}
+		Terrain = selected;
+
+		swapped = true;
+	}
+
+	task->Complete = true;
+	if (on_complete)
+	{
+		on_complete(swapped);
+	}
+}
+
+/// Map Generator Components ///
+
+void UMapGenerator::MapFlat(float Height)
+{
+	UHeightMap* Map = GetMap();
+	int32 width_x = Map->GetWidthX();
+	GenerateRows(Map, CurrentTask.Get(), [Height, width_x](int32 y, float* heights) {
+		for (int32 x = 0; x < width_x; ++x)
+		{
+			heights[x] = Height;
+		}
+		});
 }
 
 void UMapGenerator::MapPlasma(int32 Scale, float MaxHeight)
@@ -130,7 +533,7 @@ void UMapGenerator::MapPlasma(int32 Scale, float MaxHeight)
 		Scale = 1;
 	}
 
-	UHeightMap* Map = Terrain->GetMap();
+	UHeightMap* Map = GetMap();
 
 	int32 width_x = Map->GetWidthX();
 	int32 width_y = Map->GetWidthY();
@@ -140,13 +543,12 @@ void UMapGenerator::MapPlasma(int32 Scale, float MaxHeight)
 	noise.Scale(width_x, width_y);
 
 	// Sample the noise onto the terrain
-	for (int32 x = 0; x < width_x; ++x)
-	{
-		for (int32 y = 0; y < width_y; ++y)
+	GenerateRows(Map, CurrentTask.Get(), [&](int32 y, float* heights) {
+		for (int32 x = 0; x < width_x; ++x)
 		{
-			Map->SetHeight(x, y, noise.Cubic((float)x, (float)y) * MaxHeight);
+			heights[x] = noise.Cubic((float)x, (float)y) * MaxHeight;
 		}
-	}
+		});
 }
 
 void UMapGenerator::MapPerlin(int32 Frequency, int32 Octaves, float Persistence, float MaxHeight)
@@ -169,36 +571,75 @@ void UMapGenerator::MapPerlin(int32 Frequency, int32 Octaves, float Persistence,
 		Persistence = 1.0f;
 	}
 
-	UHeightMap* Map = Terrain->GetMap();
+	UHeightMap* Map = GetMap();
 
 	int32 width_x = Map->GetWidthX();
 	int32 width_y = Map->GetWidthY();
 
-	// Create noise data
-	std::vector<GradientNoise> noise;
+	// Create noise data, each octave has its own seed from the Perlin stream
+	FTerrainRandom random(Seed, (uint32)EGeneratorStream::Perlin);
+	TArray<GradientNoise> noise;
+	noise.Reserve(Octaves);
 	for (int32 i = 1; i <= Octaves; ++i)
 	{
-		noise.push_back(GradientNoise(Frequency * i, Frequency * i, Seed++));
-		noise.back().Scale(width_x, width_y);
+		noise.Emplace(Frequency * i, Frequency * i, random.GetUInt(i));
+		noise.Last().Scale(width_x, width_y);
 	}
 
 	// Sample the noise onto the terrain
-	for (int32 x = 0; x < width_x; ++x)
+	// Sum the amplitudes to normalize the octaves
+	float total = 0.0f;
+	float total_amplitude = 1.0f;
+	for (int32 i = 0; i < Octaves; ++i)
 	{
-		for (int32 y = 0; y < width_y; ++y)
+		total += total_amplitude;
+		total_amplitude *= Persistence;
+	}
+
+	GenerateRows(Map, CurrentTask.Get(), [&](int32 y, float* heights) {
+		TArray<float> octave;
+		octave.SetNumUninitialized(width_x);
+		FMemory::Memzero(heights, width_x * sizeof(float));
+
+		// Add each octave to the row
+		float amplitude = 1.0f;
+		for (int32 i = 0; i < Octaves; ++i)
 		{
-			float amplitude = 1.0f;
-			float total = 0.0f;
-			float height = 0.0f;
-			for (int32 i = 0; i < Octaves; ++i)
+			noise[i].PerlinRow(y, 0.0f, width_x, octave.GetData());
+			for (int32 x = 0; x < width_x; ++x)
 			{
-				height += noise[i].Perlin(x, y) * amplitude;
-				total += amplitude;
-				amplitude *= Persistence;
+				heights[x] += octave[x] * amplitude;
 			}
+			amplitude *= Persistence;
+		}
 
-			Map->SetHeight(x, y, height * MaxHeight / total);
+		for (int32 x = 0; x < width_x; ++x)
+		{
+			heights[x] *= MaxHeight / total;
+		}
+		});
+}
+
+void UMapGenerator::ErodeHydraulic(int32 Droplets)
+{
+	// Erosion can't be stopped part way, so it is skipped if the generation was cancelled before it
+	if (CurrentTask.IsValid())
+	{
+		if (CurrentTask->IsCancelled())
+		{
+			return;
 		}
+		CurrentTask->AddWork(1);
+	}
+
+	FHydraulicErosionSettings settings;
+	settings.Droplets = Droplets;
+	settings.Seed = (int32)FTerrainRandom(Seed, (uint32)EGeneratorStream::Erosion).GetUInt(0);
+	GetMap()->ErodeHydraulic(settings);
+
+	if (CurrentTask.IsValid())
+	{
+		CurrentTask->CompleteWork(1);
 	}
 }
 
@@ -207,15 +648,24 @@ void UMapGenerator::FoliageRandom(uint32 NumPoints)
 	if (NumPoints < 1)
 		return;
 
+	// Foliage is spawned on the game thread once a background generation has been swapped into the terrain
+	if (CurrentTask.IsValid())
+	{
+		DeferredFoliage.Add([this, NumPoints]() { FoliageRandom(NumPoints); });
+		return;
+	}
+
 	TArray<UTerrainFoliageSpawner*> groups;
 	Terrain->GetFoliageGroups(groups);
-	std::default_random_engine rando(Seed);
-	std::uniform_int_distribution<uint32> random_seed(0, std::numeric_limits<uint32>::max());
+	FTerrainRandom random(Seed, (uint32)EGeneratorStream::FoliageRandom);
 
 	for (int32 i = 0; i < groups.Num(); ++i)
 	{
+		// Each group draws the seeds of its noise and clusters from its own stream
+		FTerrainRandom group_random = random.GetStream(i);
+
 		// Create noise
-		PointNoise noise(Terrain->GetMap()->GetWidthX() - 3, Terrain->GetMap()->GetWidthY() - 3, NumPoints, random_seed(rando));
+		PointNoise noise(Terrain->GetMap()->GetWidthX() - 3, Terrain->GetMap()->GetWidthY() - 3, NumPoints, group_random.GetUInt(0));
 		const TArray<FVector2D>& points = noise.GetPoints();
 
 		// Add foliage objects
@@ -230,7 +680,7 @@ void UMapGenerator::FoliageRandom(uint32 NumPoints)
 			location.Y += points[p].Y * Terrain->GetActorScale3D().Y;
 
 			// Place the foliage object
-			groups[i]->AddFoliageCluster(Terrain, location, random_seed(rando));
+			groups[i]->AddFoliageCluster(Terrain, location, group_random.GetUInt(p + 1));
 		}
 	}
 }
@@ -240,15 +690,24 @@ void UMapGenerator::FoliageUniform(uint32 XPoints, uint32 YPoints)
 	if (XPoints < 1 || YPoints < 1)
 		return;
 
+	// Foliage is spawned on the game thread once a background generation has been swapped into the terrain
+	if (CurrentTask.IsValid())
+	{
+		DeferredFoliage.Add([this, XPoints, YPoints]() { FoliageUniform(XPoints, YPoints); });
+		return;
+	}
+
 	TArray<UTerrainFoliageSpawner*> groups;
 	Terrain->GetFoliageGroups(groups);
-	std::default_random_engine rando(Seed);
-	std::uniform_int_distribution<uint32> random_seed(0, std::numeric_limits<uint32>::max());
+	FTerrainRandom random(Seed, (uint32)EGeneratorStream::FoliageUniform);
 
 	for (int32 i = 0; i < groups.Num(); ++i)
 	{
+		// Each group draws the seeds of its noise and clusters from its own stream
+		FTerrainRandom group_random = random.GetStream(i);
+
 		// Create noise
-		UniformPointNoise noise(XPoints, YPoints, random_seed(rando));
+		UniformPointNoise noise(XPoints, YPoints, group_random.GetUInt(0));
 		const TArray<FVector2D>& points = noise.GetPoints();
 
 		// Add foliage objects
@@ -267,7 +726,7 @@ void UMapGenerator::FoliageUniform(uint32 XPoints, uint32 YPoints)
 			location.Y += points[p].Y * yscale;
 
 			// Place the foliage object
-			groups[i]->AddFoliageCluster(Terrain, location, random_seed(rando));
+			groups[i]->AddFoliageCluster(Terrain, location, group_random.GetUInt(p + 1));
 		}
 	}
 }
\ No newline at end of file
@@ -0,0 +1,423 @@
+#include "TerrainGraph.h"
+#include "TerrainHeightMap.h"
+#include "TerrainStat.h"
+
+#include "Algo/BinarySearch.h"
+#include "Async/ParallelFor.h"
+#include "Misc/ScopeLock.h"
+
+DECLARE_CYCLE_STAT(TEXT("Dynamic Terrain - Generate Graph"), STAT_DynamicTerrain_GenerateGraph, STATGROUP_DynamicTerrain);
+DECLARE_CYCLE_STAT(TEXT("Dynamic Terrain - Evaluate Stage"), STAT_DynamicTerrain_EvaluateStage, STATGROUP_DynamicTerrain);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dynamic Terrain - Stage Evaluations"), STAT_DynamicTerrain_StageEvaluations, STATGROUP_DynamicTerrain);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dynamic Terrain - Stage Cache Hits"), STAT_DynamicTerrain_StageCacheHits, STATGROUP_DynamicTerrain);
+DECLARE_MEMORY_STAT(TEXT("Dynamic Terrain - Stage Cache Memory"), STAT_DynamicTerrain_StageCacheMemory, STATGROUP_DynamicTerrain);
+
+// Get the amplitude of each octave, normalized so that the octaves sum to an amplitude of 1
+static TArray<float> octave_amplitudes(int32 Octaves, float Persistence)
+{
+	TArray<float> amplitudes;
+	float total = 0.0f;
+	float amplitude = 1.0f;
+	for (int32 i = 0; i < Octaves; ++i)
+	{
+		amplitudes.Add(amplitude);
+		total += amplitude;
+		amplitude *= Persistence;
+	}
+
+	for (float& octave_amplitude : amplitudes)
+	{
+		octave_amplitude /= total;
+	}
+	return amplitudes;
+}
+
+// Create octaves of noise, each with twice the frequency of the one before it and its own seed
+static TArray<HashGradientNoise> octave_noise(float Wavelength, int32 Octaves, uint32 Seed)
+{
+	FTerrainRandom random(Seed);
+	TArray<HashGradientNoise> octaves;
+	float frequency = 1.0f / Wavelength;
+	for (int32 i = 0; i < Octaves; ++i)
+	{
+		octaves.Emplace(2, 2, random.GetUInt(i));
+		octaves.Last().SetFrequency(frequency);
+		frequency *= 2.0f;
+	}
+	return octaves;
+}
+
+// Sort curve points by their input value
+static TArray<FVector2D> sort_curve(TArray<FVector2D> Points)
+{
+	Points.Sort([](const FVector2D& A, const FVector2D& B) {
+		return A.X < B.X;
+		});
+	return Points;
+}
+
+/// Stages ///
+
+FTerrainStage::FTerrainStage(TArray<FTerrainStageRef> NewInputs, uint64 ParameterHash)
+	: Inputs(MoveTemp(NewInputs))
+	, Hash(ParameterHash)
+{
+	for (const FTerrainStageRef& input : Inputs)
+	{
+		uint64 input_hash = input->GetHash();
+		Hash = HashBytes(Hash, &input_hash, sizeof(input_hash));
+	}
+}
+
+uint64 FTerrainStage::GetHash() const
+{
+	return Hash;
+}
+
+const TArray<FTerrainStageRef>& FTerrainStage::GetInputs() const
+{
+	return Inputs;
+}
+
+FTerrainSourceStage::FTerrainSourceStage(uint64 ParameterHash)
+	: FTerrainStage(TArray<FTerrainStageRef>(), ParameterHash)
+{
+
+}
+
+void FTerrainSourceStage::Evaluate(const FTerrainTile& Tile, TArrayView<const float* const> StageInputs, float* OutValues) const
+{
+	for (int32 y = 0; y < Tile.Size.Y; ++y)
+	{
+		SampleRow(Tile.Min.Y + y, Tile.Min.X, Tile.Size.X, OutValues + y * Tile.Size.X);
+	}
+}
+
+void FTerrainSourceStage::SampleRow(float Y, float X0, int32 Count, float* OutValues) const
+{
+	for (int32 i = 0; i < Count; ++i)
+	{
+		OutValues[i] = Sample(X0 + i, Y);
+	}
+}
+
+FTerrainNoiseStage::FTerrainNoiseStage(float Wavelength, uint32 Seed)
+	: FTerrainSourceStage(HashParameters(TEXT("Noise"), Wavelength, Seed))
+	, Gradient(2, 2, Seed)
+{
+	Gradient.SetFrequency(1.0f / FMath::Max(Wavelength, 1.0f));
+}
+
+float FTerrainNoiseStage::Sample(float X, float Y) const
+{
+	return Gradient.Perlin(X, Y);
+}
+
+void FTerrainNoiseStage::SampleRow(float Y, float X0, int32 Count, float* OutValues) const
+{
+	Gradient.PerlinRow(Y, X0, Count, OutValues);
+}
+
+FTerrainFBMStage::FTerrainFBMStage(float Wavelength, int32 NumOctaves, float Persistence, uint32 Seed)
+	: FTerrainSourceStage(HashParameters(TEXT("FBM"), Wavelength, NumOctaves, Persistence, Seed))
+	, Octaves(octave_noise(FMath::Max(Wavelength, 1.0f), FMath::Max(NumOctaves, 1), Seed))
+	, Amplitudes(octave_amplitudes(FMath::Max(NumOctaves, 1), FMath::Clamp(Persistence, 0.0f, 1.0f)))
+{
+
+}
+
+float FTerrainFBMStage::Sample(float X, float Y) const
+{
+	float value = 0.0f;
+	for (int32 i = 0; i < Octaves.Num(); ++i)
+	{
+		value += Octaves[i].Perlin(X, Y) * Amplitudes[i];
+	}
+	return value;
+}
+
+void FTerrainFBMStage::SampleRow(float Y, float X0, int32 Count, float* OutValues) const
+{
+	TArray<float> octave;
+	octave.SetNumUninitialized(Count);
+	FMemory::Memzero(OutValues, Count * sizeof(float));
+
+	for (int32 i = 0; i < Octaves.Num(); ++i)
+	{
+		Octaves[i].PerlinRow(Y, X0, Count, octave.GetData());
+		for (int32 x = 0; x < Count; ++x)
+		{
+			OutValues[x] += octave[x] * Amplitudes[i];
+		}
+	}
+}
+
+FTerrainRidgedStage::FTerrainRidgedStage(float Wavelength, int32 NumOctaves, float Persistence, uint32 Seed)
+	: FTerrainSourceStage(HashParameters(TEXT("Ridged"), Wavelength, NumOctaves, Persistence, Seed))
+	, Octaves(octave_noise(FMath::Max(Wavelength, 1.0f), FMath::Max(NumOctaves, 1), Seed))
+	, Amplitudes(octave_amplitudes(FMath::Max(NumOctaves, 1), FMath::Clamp(Persistence, 0.0f, 1.0f)))
+{
+
+}
+
+float FTerrainRidgedStage::Sample(float X, float Y) const
+{
+	float value = 0.0f;
+	float weight = 1.0f;
+	for (int32 i = 0; i < Octaves.Num(); ++i)
+	{
+		// Fold the noise around zero to make sharp ridges
+		float ridge = 1.0f - FMath::Abs(Octaves[i].Perlin(X, Y));
+		ridge *= ridge * weight;
+		// Details are only added near the ridges of the octave before
+		weight = FMath::Clamp(ridge * 2.0f, 0.0f, 1.0f);
+		value += ridge * Amplitudes[i];
+	}
+	return value;
+}
+
+FTerrainWarpStage::FTerrainWarpStage(FTerrainSourceStageRef NewSource, float Wavelength, float NewStrength, uint32 Seed)
+	: FTerrainSourceStage(HashParameters(TEXT("Warp"), NewSource->GetHash(), Wavelength, NewStrength, Seed))
+	, Source(NewSource)
+	, WarpX(2, 2, FTerrainRandom(Seed).GetUInt(0))
+	, WarpY(2, 2, FTerrainRandom(Seed).GetUInt(1))
+	, Strength(NewStrength)
+{
+	WarpX.SetFrequency(1.0f / FMath::Max(Wavelength, 1.0f));
+	WarpY.SetFrequency(1.0f / FMath::Max(Wavelength, 1.0f));
+}
+
+float FTerrainWarpStage::Sample(float X, float Y) const
+{
+	return Source->Sample(X + WarpX.Perlin(X, Y) * Strength, Y + WarpY.Perlin(X, Y) * Strength);
+}
+
+FTerrainCurveStage::FTerrainCurveStage(FTerrainStageRef Input, TArray<FVector2D> NewPoints)
+	: FTerrainStage({ Input }, 0)
+	, Points(sort_curve(MoveTemp(NewPoints)))
+{
+	uint64 curve_hash = HashBytes(HashParameters(TEXT("Curve")), Points.GetData(), Points.Num() * sizeof(FVector2D));
+	Hash = HashBytes(Hash, &curve_hash, sizeof(curve_hash));
+}
+
+void FTerrainCurveStage::Evaluate(const FTerrainTile& Tile, TArrayView<const float* const> StageInputs, float* OutValues) const
+{
+	const float* values = StageInputs[0];
+	int32 num = Tile.Num();
+	if (Points.Num() == 0)
+	{
+		FMemory::Memcpy(OutValues, values, num * sizeof(float));
+		return;
+	}
+
+	for (int32 i = 0; i < num; ++i)
+	{
+		float value = values[i];
+
+		// Find the first point after the value, values outside of the curve take the value of the nearest end
+		int32 next = Algo::UpperBoundBy(Points, value, [](const FVector2D& Point) { return Point.X; });
+		if (next == 0)
+		{
+			OutValues[i] = Points[0].Y;
+		}
+		else if (next == Points.Num())
+		{
+			OutValues[i] = Points.Last().Y;
+		}
+		else
+		{
+			const FVector2D& a = Points[next - 1];
+			const FVector2D& b = Points[next];
+			OutValues[i] = FMath::Lerp(a.Y, b.Y, (value - a.X) / (b.X - a.X));
+		}
+	}
+}
+
+FTerrainMaskStage::FTerrainMaskStage(FTerrainStageRef Input, float NewMin, float NewMax)
+	: FTerrainStage({ Input }, HashParameters(TEXT("Mask"), NewMin, NewMax))
+	, Min(NewMin)
+	, Max(NewMax)
+{
+
+}
+
+void FTerrainMaskStage::Evaluate(const FTerrainTile& Tile, TArrayView<const float* const> StageInputs, float* OutValues) const
+{
+	const float* values = StageInputs[0];
+	int32 num = Tile.Num();
+	for (int32 i = 0; i < num; ++i)
+	{
+		OutValues[i] = FMath::SmoothStep(Min, Max, values[i]);
+	}
+}
+
+FTerrainBlendStage::FTerrainBlendStage(FTerrainStageRef A, FTerrainStageRef B, ETerrainBlendMode NewMode, float NewAlpha)
+	: FTerrainStage({ A, B }, HashParameters(TEXT("Blend"), (uint8)NewMode, NewAlpha))
+	, Mode(NewMode)
+	, Alpha(NewAlpha)
+{
+
+}
+
+FTerrainBlendStage::FTerrainBlendStage(FTerrainStageRef A, FTerrainStageRef B, FTerrainStageRef Mask, ETerrainBlendMode NewMode)
+	: FTerrainStage({ A, B, Mask }, HashParameters(TEXT("MaskedBlend"), (uint8)NewMode))
+	, Mode(NewMode)
+	, Alpha(1.0f)
+{
+
+}
+
+void FTerrainBlendStage::Evaluate(const FTerrainTile& Tile, TArrayView<const float* const> StageInputs, float* OutValues) const
+{
+	const float* a = StageInputs[0];
+	const float* b = StageInputs[1];
+	const float* mask = StageInputs.Num() > 2 ? StageInputs[2] : nullptr;
+	int32 num = Tile.Num();
+	for (int32 i = 0; i < num; ++i)
+	{
+		float combined;
+		switch (Mode)
+		{
+		case ETerrainBlendMode::Add:
+			combined = a[i] + b[i];
+			break;
+		case ETerrainBlendMode::Multiply:
+			combined = a[i] * b[i];
+			break;
+		case ETerrainBlendMode::Max:
+			combined = FMath::Max(a[i], b[i]);
+			break;
+		case ETerrainBlendMode::Min:
+			combined = FMath::Min(a[i], b[i]);
+			break;
+		default:
+			combined = b[i];
+			break;
+		}
+
+		OutValues[i] = FMath::Lerp(a[i], combined, mask ? mask[i] : Alpha);
+	}
+}
+
+/// Graph Evaluation ///
+
+FTerrainGraph::FTerrainGraph(SIZE_T NewCacheBudget)
+	: CacheBudget(NewCacheBudget)
+{
+
+}
+
+FTerrainGraph::~FTerrainGraph()
+{
+	ClearCache();
+}
+
+TSharedRef<const TArray<float>, ESPMode::ThreadSafe> FTerrainGraph::EvaluateTile(const FTerrainStageRef& Stage, const FTerrainTile& Tile)
+{
+	FCacheKey key = { Stage->GetHash(), Tile };
+	{
+		FScopeLock lock(&Lock);
+		if (FCacheEntry* entry = Cache.Find(key))
+		{
+			INC_DWORD_STAT(STAT_DynamicTerrain_StageCacheHits);
+			entry->LastUse = ++UseCount;
+			return entry->Values.ToSharedRef();
+		}
+	}
+
+	// Evaluate the inputs over the same tile, the references keep their values alive even if they are trimmed from the cache
+	const TArray<FTerrainStageRef>& inputs = Stage->GetInputs();
+	TArray<TSharedRef<const TArray<float>, ESPMode::ThreadSafe>> input_values;
+	TArray<const float*> input_data;
+	for (const FTerrainStageRef& input : inputs)
+	{
+		input_values.Add(EvaluateTile(input, Tile));
+		input_data.Add(input_values.Last()->GetData());
+	}
+
+	TSharedRef<TArray<float>, ESPMode::ThreadSafe> values = MakeShared<TArray<float>, ESPMode::ThreadSafe>();
+	values->SetNumUninitialized(Tile.Num());
+	{
+		SCOPE_CYCLE_COUNTER(STAT_DynamicTerrain_EvaluateStage);
+		INC_DWORD_STAT(STAT_DynamicTerrain_StageEvaluations);
+		Stage->Evaluate(Tile, input_data, values->GetData());
+	}
+
+	// Another thread may have evaluated the same tile in the meantime, keep whichever was cached first
+	FScopeLock lock(&Lock);
+	FCacheEntry& entry = Cache.FindOrAdd(key);
+	if (!entry.Values.IsValid())
+	{
+		entry.Values = values;
+		CacheSize += values->GetAllocatedSize();
+		INC_MEMORY_STAT_BY(STAT_DynamicTerrain_StageCacheMemory, values->GetAllocatedSize());
+	}
+	entry.LastUse = ++UseCount;
+	TSharedRef<const TArray<float>, ESPMode::ThreadSafe> result = entry.Values.ToSharedRef();
+
+	// Keep to the budget while generating, tiles still being read by other threads are kept alive by their references
+	if (CacheSize > CacheBudget)
+	{
+		TrimCache();
+	}
+	return result;
+}
+
+void FTerrainGraph::Generate(const FTerrainStageRef& Stage, UHeightMap* Map, float Scale, int32 TileSize)
+{
+	SCOPE_CYCLE_COUNTER(STAT_DynamicTerrain_GenerateGraph);
+
+	TileSize = FMath::Max(TileSize, 1);
+	int32 width_x = Map->GetWidthX();
+	int32 width_y = Map->GetWidthY();
+	int32 tiles_x = FMath::DivideAndRoundUp(width_x, TileSize);
+	int32 tiles_y = FMath::DivideAndRoundUp(width_y, TileSize);
+
+	// Each tile writes a separate block of the map
+	ParallelFor(tiles_x * tiles_y, [&](int32 Index) {
+		FTerrainTile tile;
+		tile.Min = FIntPoint(Index % tiles_x * TileSize, Index / tiles_x * TileSize);
+		tile.Size = FIntPoint(FMath::Min(TileSize, width_x - tile.Min.X), FMath::Min(TileSize, width_y - tile.Min.Y));
+
+		TSharedRef<const TArray<float>, ESPMode::ThreadSafe> values = EvaluateTile(Stage, tile);
+		for (int32 y = 0; y < tile.Size.Y; ++y)
+		{
+			for (int32 x = 0; x < tile.Size.X; ++x)
+			{
+				Map->SetHeight(tile.Min.X + x, tile.Min.Y + y, (*values)[y * tile.Size.X + x] * Scale);
+			}
+		}
+		});
+}
+
+void FTerrainGraph::ClearCache()
+{
+	FScopeLock lock(&Lock);
+	DEC_MEMORY_STAT_BY(STAT_DynamicTerrain_StageCacheMemory, CacheSize);
+	Cache.Empty();
+	CacheSize = 0;
+}
+
+void FTerrainGraph::TrimCache()
+{
+	if (CacheSize <= CacheBudget)
+	{
+		return;
+	}
+
+	// Trim well below the budget, so the sort isn't repeated for every tile added while generating
+	SIZE_T target = CacheBudget / 4 * 3;
+
+	// Remove the tiles that have gone the longest without being used
+	Cache.ValueSort([](const FCacheEntry& A, const FCacheEntry& B) {
+		return A.LastUse < B.LastUse;
+		});
+	for (auto it = Cache.CreateIterator(); it && CacheSize > target; ++it)
+	{
+		SIZE_T size = it.Value().Values->GetAllocatedSize();
+		CacheSize -= size;
+		DEC_MEMORY_STAT_BY(STAT_DynamicTerrain_StageCacheMemory, size);
+		it.RemoveCurrent();
+	}
+	Cache.Compact();
+}
\ No newline at end of file
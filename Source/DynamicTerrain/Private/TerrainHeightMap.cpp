@@ -1,4 +1,5 @@
 #include "TerrainHeightMap.h"
+#include "TerrainErosion.h"
 
 /// Blueprint Functions ///
 
@@ -26,6 +27,22 @@ float UHeightMap::BPGetHeight(int32 X, int32 Y) const
 	return GetHeight(X, Y);
 }
 
+void UHeightMap::ErodeHydraulic(const FHydraulicErosionSettings& Settings)
+{
+	if (WidthX < 2 || WidthY < 2)
+	{
+		return;
+	}
+
+	FHydraulicErosion erosion(Settings);
+	erosion.Erode(MapData.GetData(), WidthX, WidthY);
+}
+
+void UHeightMap::ErodeThermal(const FThermalErosionSettings& Settings)
+{
+	ErodeThermalRange(Settings, FIntRect(0, 0, WidthX, WidthY));
+}
+
 /// Native Functions ///
 
 void UHeightMap::GetMapSection(FMapSection* Section, FIntPoint Min)
@@ -152,6 +169,42 @@ void UHeightMap::SetHeight(uint32 X, uint32 Y, float Height)
 	MapData[Y * WidthX + X] = Height;
 }
 
+void UHeightMap::CopyMap(const UHeightMap* Other)
+{
+	WidthX = Other->WidthX;
+	WidthY = Other->WidthY;
+	MapData = Other->MapData;
+}
+
+FIntRect UHeightMap::SwapMap(UHeightMap* Other)
+{
+	if (WidthX != Other->WidthX || WidthY != Other->WidthY)
+	{
+		return FIntRect();
+	}
+
+	// Compare whole rows, which is enough to limit the sections updated after generating part of a map
+	int32 first = WidthY;
+	int32 last = -1;
+	for (int32 y = 0; y < WidthY; ++y)
+	{
+		if (FMemory::Memcmp(MapData.GetData() + y * WidthX, Other->MapData.GetData() + y * WidthX, WidthX * sizeof(float)) != 0)
+		{
+			first = FMath::Min(first, y);
+			last = y;
+		}
+	}
+
+	Swap(MapData, Other->MapData);
+	return last < first ? FIntRect() : FIntRect(0, first, WidthX, last + 1);
+}
+
+void UHeightMap::ErodeThermalRange(const FThermalErosionSettings& Settings, FIntRect Range)
+{
+	FThermalErosion erosion(Settings);
+	erosion.Erode(MapData.GetData(), WidthX, WidthY, Range);
+}
+
 int32 UHeightMap::GetWidthX() const
 {
 	return WidthX;
@@ -160,4 +213,10 @@ int32 UHeightMap::GetWidthX() const
 int32 UHeightMap::GetWidthY() const
 {
 	return WidthY;
+}
+
+uint32 UHeightMap::GetContentHash() const
+{
+	uint32 hash = FCrc::MemCrc32(&WidthX, sizeof(WidthX), WidthY);
+	return FCrc::MemCrc32(MapData.GetData(), MapData.Num() * sizeof(float), hash);
 }
\ No newline at end of file
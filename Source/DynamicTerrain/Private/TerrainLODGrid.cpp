@@ -0,0 +1,263 @@
+#include "TerrainLODGrid.h"
+#include "TerrainStat.h"
+
+#include "Misc/ScopeLock.h"
+
+DECLARE_CYCLE_STAT(TEXT("Dynamic Terrain - Horizon Culling"), STAT_DynamicTerrain_HorizonCulling, STATGROUP_DynamicTerrain);
+
+// The number of azimuth bins in the horizon buffer
+constexpr int32 horizon_bins = 1024;
+
+FTerrainLODGrid::FTerrainLODGrid(int32 XWidth, int32 YWidth)
+{
+	WidthX = FMath::Max(0, XWidth);
+	WidthY = FMath::Max(0, YWidth);
+	Cells.SetNum(WidthX * WidthY);
+}
+
+int32 FTerrainLODGrid::GetWidthX() const
+{
+	return WidthX;
+}
+
+int32 FTerrainLODGrid::GetWidthY() const
+{
+	return WidthY;
+}
+
+void FTerrainLODGrid::SetCell(int32 X, int32 Y, const FTerrainLODCell& Cell, const void* Owner)
+{
+	FScopeLock lock(&Lock);
+
+	FOwnedCell* cell = FindCell(X, Y);
+	if (cell != nullptr)
+	{
+		cell->Cell = Cell;
+		cell->Owner = Owner;
+	}
+}
+
+void FTerrainLODGrid::ClearCell(int32 X, int32 Y, const void* Owner)
+{
+	FScopeLock lock(&Lock);
+
+	FOwnedCell* cell = FindCell(X, Y);
+	if (cell != nullptr && cell->Owner == Owner)
+	{
+		cell->Owner = nullptr;
+	}
+}
+
+bool FTerrainLODGrid::GetCell(int32 X, int32 Y, FTerrainLODCell& OutCell) const
+{
+	FScopeLock lock(&Lock);
+
+	const FOwnedCell* cell = FindCell(X, Y);
+	if (cell == nullptr || cell->Owner == nullptr)
+	{
+		return false;
+	}
+
+	OutCell = cell->Cell;
+	return true;
+}
+
+bool FTerrainLODGrid::IsHorizonOccluded(int32 X, int32 Y, const FVector& ViewOrigin, uint32 FrameNumber) const
+{
+	if (X < 0 || Y < 0 || X >= WidthX || Y >= WidthY)
+	{
+		return false;
+	}
+
+	FScopeLock lock(&Lock);
+
+	int32 index = Y * WidthX + X;
+	return Cells[index].Cell.Bounds.GetBox().Max.Z < FindHorizon(ViewOrigin, FrameNumber).HiddenHeights[index];
+}
+
+float FTerrainLODGrid::GetHorizonHeight(int32 X, int32 Y, const FVector& ViewOrigin, uint32 FrameNumber) const
+{
+	if (X < 0 || Y < 0 || X >= WidthX || Y >= WidthY)
+	{
+		return -MAX_flt;
+	}
+
+	FScopeLock lock(&Lock);
+
+	return FindHorizon(ViewOrigin, FrameNumber).HiddenHeights[Y * WidthX + X];
+}
+
+const FTerrainLODGrid::FHorizonResult& FTerrainLODGrid::FindHorizon(const FVector& ViewOrigin, uint32 FrameNumber) const
+{
+	// Reuse the result of another proxy that was drawn for the same view this frame
+	FHorizonResult* result = HorizonResults.FindByPredicate([&](const FHorizonResult& Result) {
+		return Result.FrameNumber == FrameNumber && Result.ViewOrigin == ViewOrigin;
+		});
+
+	if (result == nullptr)
+	{
+		// Replace the least recently used result of an earlier frame, results of this frame belong to other views
+		for (FHorizonResult& other : HorizonResults)
+		{
+			if (other.FrameNumber != FrameNumber && (result == nullptr || other.FrameNumber < result->FrameNumber))
+			{
+				result = &other;
+			}
+		}
+
+		if (result == nullptr)
+		{
+			result = &HorizonResults.AddDefaulted_GetRef();
+		}
+
+		result->ViewOrigin = ViewOrigin;
+		result->FrameNumber = FrameNumber;
+		ComputeHorizon(ViewOrigin, result->HiddenHeights);
+	}
+
+	return *result;
+}
+
+FTerrainLODGrid::FOwnedCell* FTerrainLODGrid::FindCell(int32 X, int32 Y)
+{
+	if (X < 0 || Y < 0 || X >= WidthX || Y >= WidthY)
+	{
+		return nullptr;
+	}
+
+	return &Cells[Y * WidthX + X];
+}
+
+const FTerrainLODGrid::FOwnedCell* FTerrainLODGrid::FindCell(int32 X, int32 Y) const
+{
+	if (X < 0 || Y < 0 || X >= WidthX || Y >= WidthY)
+	{
+		return nullptr;
+	}
+
+	return &Cells[Y * WidthX + X];
+}
+
+void FTerrainLODGrid::ComputeHorizon(const FVector& ViewOrigin, TArray<float>& OutHiddenHeights) const
+{
+	SCOPE_CYCLE_COUNTER(STAT_DynamicTerrain_HorizonCulling);
+
+	OutHiddenHeights.Init(-MAX_flt, Cells.Num());
+
+	// The view from the origin of every cell that is not under the view
+	struct FHorizonCell
+	{
+		int32 Index;
+		// The azimuth range covered by the cell
+		float MinAngle;
+		float MaxAngle;
+		// The nearest and farthest horizontal distances to the cell
+		float MinDistance;
+		float MaxDistance;
+		// The steepest slope from the view to the top of the cell
+		float TopSlope;
+		// The slope below which every ray crossing the cell hits its surface
+		float HorizonSlope;
+	};
+
+	TArray<FHorizonCell> view_cells;
+	view_cells.Reserve(Cells.Num());
+	for (int32 i = 0; i < Cells.Num(); ++i)
+	{
+		const FOwnedCell& owned = Cells[i];
+		if (owned.Owner == nullptr)
+		{
+			continue;
+		}
+
+		// Cells under the view are always visible and can't be placed on the horizon
+		FBox box = owned.Cell.Bounds.GetBox();
+		if (ViewOrigin.X >= box.Min.X && ViewOrigin.X <= box.Max.X && ViewOrigin.Y >= box.Min.Y && ViewOrigin.Y <= box.Max.Y)
+		{
+			continue;
+		}
+
+		FHorizonCell& cell = view_cells.AddDefaulted_GetRef();
+		cell.Index = i;
+
+		// Find the azimuth range around the direction of the center, which never wraps since the view is outside of the cell
+		FVector2D center = FVector2D(box.GetCenter()) - FVector2D(ViewOrigin);
+		float center_angle = FMath::Atan2(center.Y, center.X);
+		cell.MinAngle = MAX_flt;
+		cell.MaxAngle = -MAX_flt;
+		cell.MaxDistance = 0.0f;
+		for (int32 corner = 0; corner < 4; ++corner)
+		{
+			FVector2D offset = FVector2D((corner & 1) ? box.Max.X : box.Min.X, (corner & 2) ? box.Max.Y : box.Min.Y) - FVector2D(ViewOrigin);
+			float angle = center_angle + FMath::UnwindRadians(FMath::Atan2(offset.Y, offset.X) - center_angle);
+			cell.MinAngle = FMath::Min(cell.MinAngle, angle);
+			cell.MaxAngle = FMath::Max(cell.MaxAngle, angle);
+			cell.MaxDistance = FMath::Max(cell.MaxDistance, offset.Size());
+		}
+
+		FVector2D nearest = FVector2D(FMath::Clamp(ViewOrigin.X, box.Min.X, box.Max.X), FMath::Clamp(ViewOrigin.Y, box.Min.Y, box.Max.Y)) - FVector2D(ViewOrigin);
+		cell.MinDistance = FMath::Max(nearest.Size(), KINDA_SMALL_NUMBER);
+
+		// The top of the cell is steepest at its nearest point when above the view and at its farthest point when below
+		float top = box.Max.Z - ViewOrigin.Z;
+		cell.TopSlope = top > 0.0f ? top / cell.MinDistance : top / cell.MaxDistance;
+
+		// A ray crosses the cell somewhere between its nearest and farthest distance, so the horizon uses the least blocking of them
+		float bottom = box.Min.Z - ViewOrigin.Z;
+		cell.HorizonSlope = owned.Cell.bOccluder ? (bottom > 0.0f ? bottom / cell.MaxDistance : bottom / cell.MinDistance) : -MAX_flt;
+	}
+
+	// Visit the cells front to back
+	view_cells.Sort([](const FHorizonCell& A, const FHorizonCell& B) {
+		return A.MinDistance < B.MinDistance;
+		});
+
+	// Cells only join the horizon once they are entirely in front of the cells being tested
+	TArray<const FHorizonCell*> pending;
+	auto pending_order = [](const FHorizonCell& A, const FHorizonCell& B) {
+		return A.MaxDistance < B.MaxDistance;
+	};
+
+	TArray<float> horizon;
+	horizon.Init(-MAX_flt, horizon_bins);
+	const float bin_scale = horizon_bins / (2.0f * PI);
+	auto get_bin = [](int32 Bin) {
+		return ((Bin % horizon_bins) + horizon_bins) % horizon_bins;
+	};
+
+	for (const FHorizonCell& cell : view_cells)
+	{
+		// Add the cells that are now in front to every bin they fully cover
+		while (pending.Num() > 0 && pending.HeapTop()->MaxDistance <= cell.MinDistance)
+		{
+			const FHorizonCell* occluder = nullptr;
+			pending.HeapPop(occluder, pending_order, false);
+
+			int32 last_bin = FMath::FloorToInt((occluder->MaxAngle + PI) * bin_scale);
+			for (int32 bin = FMath::CeilToInt((occluder->MinAngle + PI) * bin_scale); bin < last_bin; ++bin)
+			{
+				float& slope = horizon[get_bin(bin)];
+				slope = FMath::Max(slope, occluder->HorizonSlope);
+			}
+		}
+
+		// Anything over the cell is hidden if it stays below the lowest horizon of the bins the cell touches
+		float horizon_slope = MAX_flt;
+		int32 last_bin = FMath::FloorToInt((cell.MaxAngle + PI) * bin_scale);
+		for (int32 bin = FMath::FloorToInt((cell.MinAngle + PI) * bin_scale); bin <= last_bin && horizon_slope > -MAX_flt; ++bin)
+		{
+			horizon_slope = FMath::Min(horizon_slope, horizon[get_bin(bin)]);
+		}
+
+		// Heights above the view are steepest at the nearest point of the cell, heights below it at the farthest
+		if (horizon_slope > -MAX_flt)
+		{
+			OutHiddenHeights[cell.Index] = ViewOrigin.Z + horizon_slope * (horizon_slope > 0.0f ? cell.MinDistance : cell.MaxDistance);
+		}
+
+		if (Cells[cell.Index].Cell.bOccluder)
+		{
+			pending.HeapPush(&cell, pending_order);
+		}
+	}
+}
\ No newline at end of file
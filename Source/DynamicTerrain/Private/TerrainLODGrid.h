@@ -0,0 +1,74 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// The data a scene proxy shares with its neighbors to select LODs
+struct FTerrainLODCell
+{
+	// The world bounds of the component
+	FBoxSphereBounds Bounds;
+	// The maximum vertical error of each LOD against full resolution, in local units
+	TArray<float, TInlineAllocator<8>> LODErrors;
+	// Whether the XY footprint of the bounds matches the surface, which lets the cell hide the cells behind it
+	bool bOccluder = false;
+};
+
+// LOD data of every component of a terrain, used by scene proxies to find the LODs of their neighbors
+// Cells are written on the rendering thread and read under a lock from any thread, the grid itself can be created on any thread
+class FTerrainLODGrid
+{
+public:
+	FTerrainLODGrid(int32 XWidth, int32 YWidth);
+
+	// Get the number of components on the X axis
+	int32 GetWidthX() const;
+	// Get the number of components on the Y axis
+	int32 GetWidthY() const;
+
+	// Set the data of the component at a grid position, Owner is used to avoid clearing cells owned by a newer proxy
+	void SetCell(int32 X, int32 Y, const FTerrainLODCell& Cell, const void* Owner);
+	// Clear a cell if it is still owned by Owner
+	void ClearCell(int32 X, int32 Y, const void* Owner);
+	// Get the data of the component at a grid position, returns false if there is no component there
+	bool GetCell(int32 X, int32 Y, FTerrainLODCell& OutCell) const;
+
+	// Check if a cell is hidden behind nearer cells when seen from a view origin
+	// The result is computed for every cell once per frame and origin, then shared by all proxies of the terrain
+	bool IsHorizonOccluded(int32 X, int32 Y, const FVector& ViewOrigin, uint32 FrameNumber) const;
+	// Get the world height below which anything over a cell is hidden behind nearer cells, -MAX_flt if nothing is hidden
+	// Used to cull objects standing on the terrain such as foliage, which reach above the bounds of their cell
+	float GetHorizonHeight(int32 X, int32 Y, const FVector& ViewOrigin, uint32 FrameNumber) const;
+
+private:
+	struct FOwnedCell
+	{
+		FTerrainLODCell Cell;
+		const void* Owner = nullptr;
+	};
+
+	// The horizon of every cell seen from a view origin in a frame
+	struct FHorizonResult
+	{
+		FVector ViewOrigin;
+		uint32 FrameNumber = 0;
+		TArray<float> HiddenHeights;
+	};
+
+	// Find a cell, returns null for positions outside of the grid
+	FOwnedCell* FindCell(int32 X, int32 Y);
+	const FOwnedCell* FindCell(int32 X, int32 Y) const;
+	// Get the horizon seen from a view origin in a frame, computing it if needed, must be called with the lock held
+	const FHorizonResult& FindHorizon(const FVector& ViewOrigin, uint32 FrameNumber) const;
+	// Find the height below which each cell is hidden from a view origin, must be called with the lock held
+	void ComputeHorizon(const FVector& ViewOrigin, TArray<float>& OutHiddenHeights) const;
+
+	// The size of the grid
+	int32 WidthX;
+	int32 WidthY;
+	// The cells of the grid
+	TArray<FOwnedCell> Cells;
+	// Recently computed horizon results, grows to the number of views drawn in a single frame
+	mutable TArray<FHorizonResult, TInlineAllocator<4>> HorizonResults;
+	// Guards access to the cells
+	mutable FCriticalSection Lock;
+};
\ No newline at end of file
@@ -0,0 +1,178 @@
+#include "TerrainQuadtreeComponent.h"
+
+#include "Terrain.h"
+#include "TerrainQuadtreeRender.h"
+
+#include "RHI.h"
+
+/// Mesh Component Interface ///
+
+UTerrainQuadtreeComponent::UTerrainQuadtreeComponent(const FObjectInitializer& ObjectInitializer)
+{
+	// Collision is provided by the terrain components
+	PrimaryComponentTick.bCanEverTick = false;
+	SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	SetCanEverAffectNavigation(false);
+}
+
+FPrimitiveSceneProxy* UTerrainQuadtreeComponent::CreateSceneProxy()
+{
+	ATerrain* terrain = Cast<ATerrain>(GetOwner());
+	if (terrain == nullptr || Size <= 1 || XWidth < 1 || YWidth < 1)
+	{
+		return nullptr;
+	}
+
+	// Make sure the heightmap matches the layout the component was initialized with
+	UHeightMap* map = terrain->GetMap();
+	int32 polygons = GetTerrainComponentWidth(Size) - 1;
+	if (map == nullptr || map->GetWidthX() != polygons * XWidth + 3 || map->GetWidthY() != polygons * YWidth + 3 || !IsMapSupported(map))
+	{
+		return nullptr;
+	}
+
+	// Give the proxy its own copy of the heightmap
+	TSharedPtr<FMapSection, ESPMode::ThreadSafe> map_data = MakeShareable(new FMapSection(map->GetWidthX(), map->GetWidthY()));
+	map->GetMapSection(map_data.Get(), FIntPoint(0, 0));
+
+	// Remember the heights the proxy starts with, so later initializations only upload the sections that differ
+	FMapSection section(polygons + 3, polygons + 3);
+	SectionHashes.SetNumUninitialized(XWidth * YWidth);
+	for (int32 y = 0; y < YWidth; ++y)
+	{
+		for (int32 x = 0; x < XWidth; ++x)
+		{
+			GetSection(map, x, y, section);
+			SectionHashes[y * XWidth + x] = section.GetHash();
+		}
+	}
+
+	return new FTerrainQuadtreeSceneProxy(this, map_data);
+}
+
+int32 UTerrainQuadtreeComponent::GetNumMaterials() const
+{
+	return 1;
+}
+
+FBoxSphereBounds UTerrainQuadtreeComponent::CalcBounds(const FTransform& LocalToWorld) const
+{
+	// The terrain is centered on the component
+	float polygons = GetTerrainComponentWidth(Size) - 1;
+	FVector extent(polygons * XWidth / 2.0f, polygons * YWidth / 2.0f, 0.0f);
+	FBox box(FVector(-extent.X, -extent.Y, MinHeight), FVector(extent.X, extent.Y, MaxHeight));
+
+	return FBoxSphereBounds(box.TransformBy(LocalToWorld));
+}
+
+/// Terrain Interface ///
+
+void UTerrainQuadtreeComponent::Initialize(ATerrain* Terrain)
+{
+	bool same_layout = Size == Terrain->GetComponentSize() && XWidth == Terrain->GetXWidth() && YWidth == Terrain->GetYWidth();
+
+	Size = Terrain->GetComponentSize();
+	XWidth = Terrain->GetXWidth();
+	YWidth = Terrain->GetYWidth();
+	Tiling = Terrain->GetTiling();
+	RangeScale = Terrain->GetQuadtreeRangeScale();
+
+	// Find the height range of the whole map
+	UHeightMap* map = Terrain->GetMap();
+	MinHeight = 0.0f;
+	MaxHeight = 0.0f;
+	for (int32 y = 0; y < map->GetWidthY(); ++y)
+	{
+		for (int32 x = 0; x < map->GetWidthX(); ++x)
+		{
+			float height = map->GetHeight(x, y);
+			if ((x == 0 && y == 0) || height < MinHeight)
+			{
+				MinHeight = height;
+			}
+			if ((x == 0 && y == 0) || height > MaxHeight)
+			{
+				MaxHeight = height;
+			}
+		}
+	}
+
+	UpdateBounds();
+
+	// A proxy with the same layout keeps its resources, so only its parameters and the sections that changed are updated
+	FTerrainQuadtreeSceneProxy* proxy = (FTerrainQuadtreeSceneProxy*)SceneProxy;
+	if (!same_layout || proxy == nullptr || SectionHashes.Num() != XWidth * YWidth)
+	{
+		MarkRenderStateDirty();
+		return;
+	}
+
+	ENQUEUE_RENDER_COMMAND(FQuadtreeParameterUpdate)([proxy, tiling = Tiling, range_scale = RangeScale](FRHICommandListImmediate& RHICmdList) {
+		proxy->SetParameters(tiling, range_scale);
+		});
+
+	int32 width = GetTerrainComponentWidth(Size);
+	for (int32 y = 0; y < YWidth; ++y)
+	{
+		for (int32 x = 0; x < XWidth; ++x)
+		{
+			TSharedPtr<FMapSection, ESPMode::ThreadSafe> section = MakeShareable(new FMapSection(width + 2, width + 2));
+			GetSection(map, x, y, *section);
+			if (section->GetHash() != SectionHashes[y * XWidth + x])
+			{
+				UpdateSection(x, y, section);
+			}
+		}
+	}
+	MarkRenderTransformDirty();
+}
+
+void UTerrainQuadtreeComponent::UpdateSection(int32 X, int32 Y, TSharedPtr<FMapSection, ESPMode::ThreadSafe> Section)
+{
+	// Grow the bounds to fit the new heights
+	bool grown = false;
+	for (int32 i = 0; i < Section->Data.Num(); ++i)
+	{
+		if (Section->Data[i] < MinHeight)
+		{
+			MinHeight = Section->Data[i];
+			grown = true;
+		}
+		if (Section->Data[i] > MaxHeight)
+		{
+			MaxHeight = Section->Data[i];
+			grown = true;
+		}
+	}
+	if (grown)
+	{
+		UpdateBounds();
+		MarkRenderTransformDirty();
+	}
+
+	// Update the scene proxy
+	FTerrainQuadtreeSceneProxy* proxy = (FTerrainQuadtreeSceneProxy*)SceneProxy;
+	if (proxy != nullptr)
+	{
+		if (SectionHashes.IsValidIndex(Y * XWidth + X))
+		{
+			SectionHashes[Y * XWidth + X] = Section->GetHash();
+		}
+
+		ENQUEUE_RENDER_COMMAND(FQuadtreeSectionUpdate)([proxy, X, Y, Section](FRHICommandListImmediate& RHICmdList) {
+			proxy->UpdateSection(X, Y, Section);
+			});
+	}
+}
+
+bool UTerrainQuadtreeComponent::IsMapSupported(const UHeightMap* Map)
+{
+	int32 max_dimension = GMaxTextureDimensions;
+	return Map != nullptr && Map->GetWidthX() <= max_dimension && Map->GetWidthY() <= max_dimension;
+}
+
+void UTerrainQuadtreeComponent::GetSection(UHeightMap* Map, int32 X, int32 Y, FMapSection& OutSection) const
+{
+	int32 polygons = GetTerrainComponentWidth(Size) - 1;
+	Map->GetMapSection(&OutSection, FIntPoint(X * polygons, Y * polygons));
+}
\ No newline at end of file
@@ -0,0 +1,510 @@
+#include "TerrainQuadtreeRender.h"
+#include "TerrainQuadtreeComponent.h"
+#include "TerrainTopology.h"
+#include "TerrainStat.h"
+#include "Terrain.h"
+
+#include "Engine.h"
+#include "Materials/Material.h"
+#include "MeshMaterialShader.h"
+#include "ShaderParameterUtils.h"
+
+DECLARE_CYCLE_STAT(TEXT("Dynamic Terrain - Quadtree Selection"), STAT_DynamicTerrain_QuadtreeSelection, STATGROUP_DynamicTerrain);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dynamic Terrain - Quadtree Nodes"), STAT_DynamicTerrain_QuadtreeNodes, STATGROUP_DynamicTerrain);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dynamic Terrain - Quadtree Draws"), STAT_DynamicTerrain_QuadtreeDraws, STATGROUP_DynamicTerrain);
+DECLARE_MEMORY_STAT(TEXT("Dynamic Terrain - Quadtree Heightmap Texture Memory (GPU)"), STAT_DynamicTerrain_QuadtreeTextureMemory, STATGROUP_DynamicTerrain);
+DECLARE_MEMORY_STAT(TEXT("Dynamic Terrain - Quadtree Patch Buffer Memory"), STAT_DynamicTerrain_QuadtreeBufferMemory, STATGROUP_DynamicTerrain);
+DECLARE_MEMORY_STAT(TEXT("Dynamic Terrain - Quadtree Map Memory (CPU)"), STAT_DynamicTerrain_QuadtreeMapMemory, STATGROUP_DynamicTerrain);
+
+// The portion of a level's range that is drawn without morphing
+constexpr float morph_start_ratio = 0.66f;
+// The smallest range scale which keeps neighboring nodes within one level of each other
+constexpr float min_range_scale = 4.5f;
+
+/// Vertex Factory ///
+
+class FTerrainVertexFactoryShaderParameters : public FVertexFactoryShaderParameters
+{
+	DECLARE_TYPE_LAYOUT(FTerrainVertexFactoryShaderParameters, NonVirtual);
+
+public:
+	void Bind(const FShaderParameterMap& ParameterMap)
+	{
+		MorphParams.Bind(ParameterMap, TEXT("TerrainMorphParams"));
+		MapParams.Bind(ParameterMap, TEXT("TerrainMapParams"));
+		HeightmapSize.Bind(ParameterMap, TEXT("TerrainHeightmapSize"));
+		Heightmap.Bind(ParameterMap, TEXT("TerrainHeightmap"));
+		HeightmapSampler.Bind(ParameterMap, TEXT("TerrainHeightmapSampler"));
+	}
+
+	void GetElementShaderBindings(const FSceneInterface* Scene, const FSceneView* View, const FMeshMaterialShader* Shader, const EVertexInputStreamType InputStreamType, ERHIFeatureLevel::Type FeatureLevel, const FVertexFactory* VertexFactory, const FMeshBatchElement& BatchElement, FMeshDrawSingleShaderBindings& ShaderBindings, FVertexInputStreamArray& VertexStreams) const
+	{
+		const FTerrainVertexFactory* terrain_factory = (const FTerrainVertexFactory*)VertexFactory;
+		const FTerrainBatchUserData* batch = (const FTerrainBatchUserData*)BatchElement.UserData;
+
+		ShaderBindings.Add(MorphParams, batch->MorphParams);
+		ShaderBindings.Add(MapParams, terrain_factory->MapParams);
+		ShaderBindings.Add(HeightmapSize, terrain_factory->HeightmapSize);
+		ShaderBindings.AddTexture(Heightmap, HeightmapSampler, TStaticSamplerState<SF_Bilinear, AM_Clamp, AM_Clamp, AM_Clamp>::GetRHI(), terrain_factory->Heightmap);
+
+		// Bind the nodes of the batch to the instance stream
+		if (terrain_factory->InstanceStreamIndex >= 0 && batch->InstanceBuffer != nullptr)
+		{
+			VertexStreams.Add(FVertexInputStream(terrain_factory->InstanceStreamIndex, batch->InstanceOffset, batch->InstanceBuffer->VertexBufferRHI));
+		}
+	}
+
+private:
+	LAYOUT_FIELD(FShaderParameter, MorphParams);
+	LAYOUT_FIELD(FShaderParameter, MapParams);
+	LAYOUT_FIELD(FShaderParameter, HeightmapSize);
+	LAYOUT_FIELD(FShaderResourceParameter, Heightmap);
+	LAYOUT_FIELD(FShaderResourceParameter, HeightmapSampler);
+};
+
+IMPLEMENT_TYPE_LAYOUT(FTerrainVertexFactoryShaderParameters);
+IMPLEMENT_VERTEX_FACTORY_PARAMETER_TYPE(FTerrainVertexFactory, SF_Vertex, FTerrainVertexFactoryShaderParameters);
+IMPLEMENT_VERTEX_FACTORY_TYPE(FTerrainVertexFactory, "/Plugin/DynamicTerrain/Private/TerrainVertexFactory.ush", true, false, true, false, false);
+
+FTerrainVertexFactory::FTerrainVertexFactory(ERHIFeatureLevel::Type InFeatureLevel) : FVertexFactory(InFeatureLevel)
+{
+}
+
+bool FTerrainVertexFactory::ShouldCompilePermutation(const FVertexFactoryShaderPermutationParameters& Parameters)
+{
+	// Patches are never tessellated
+	return (Parameters.MaterialParameters.MaterialDomain == MD_Surface && Parameters.MaterialParameters.TessellationMode == MTM_NoTessellation) || Parameters.MaterialParameters.bIsSpecialEngineMaterial;
+}
+
+void FTerrainVertexFactory::ModifyCompilationEnvironment(const FVertexFactoryShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+{
+	OutEnvironment.SetDefine(TEXT("DYNAMIC_TERRAIN_VERTEX_FACTORY"), 1);
+}
+
+void FTerrainVertexFactory::InitRHI()
+{
+	FVertexDeclarationElementList elements;
+	elements.Add(AccessStreamComponent(FVertexStreamComponent(PositionBuffer, 0, sizeof(FVector2D), VET_Float2), 0));
+
+	// The node stream changes every frame, so it is overridden by each mesh batch
+	elements.Add(AccessStreamComponent(FVertexStreamComponent(nullptr, 0, sizeof(FVector4), VET_Float4, EVertexStreamUsage::Instancing | EVertexStreamUsage::Overridden), 1));
+	InstanceStreamIndex = Streams.Num() - 1;
+
+	InitDeclaration(elements);
+}
+
+void FTerrainPatchVertexBuffer::InitRHI()
+{
+	uint32 size = Positions.Num() * sizeof(FVector2D);
+	FRHIResourceCreateInfo create_info;
+	VertexBufferRHI = RHICreateVertexBuffer(size, BUF_Static, create_info);
+
+	void* vertex_data = RHILockVertexBuffer(VertexBufferRHI, 0, size, RLM_WriteOnly);
+	FMemory::Memcpy(vertex_data, Positions.GetData(), size);
+	RHIUnlockVertexBuffer(VertexBufferRHI);
+}
+
+/// Scene Proxy ///
+
+FTerrainQuadtreeSceneProxy::FTerrainQuadtreeSceneProxy(UTerrainQuadtreeComponent* Component, TSharedPtr<FMapSection, ESPMode::ThreadSafe> MapData) : FPrimitiveSceneProxy(Component), VertexFactory(GetScene().GetFeatureLevel()), MaterialRelevance(Component->GetMaterialRelevance(GetScene().GetFeatureLevel()))
+{
+	Map = MapData;
+	Size = Component->Size;
+	XWidth = Component->XWidth;
+	YWidth = Component->YWidth;
+	Tiling = Component->Tiling;
+	RangeScale = FMath::Max(Component->RangeScale, min_range_scale);
+	NumLevels = FMath::CeilLogTwo(FMath::Max(XWidth, YWidth)) + 1;
+
+	// Every node draws the full resolution grid of a terrain component
+	uint32 width = GetTerrainComponentWidth(Size);
+	VertexBuffer.Positions.SetNumUninitialized(width * width);
+	for (uint32 y = 0; y < width; ++y)
+	{
+		for (uint32 x = 0; x < width; ++x)
+		{
+			VertexBuffer.Positions[y * width + x] = FVector2D(x, y);
+		}
+	}
+	IndexBuffer.Indices = FTerrainTopology::Get(Size)->GetGridIndices();
+
+	// Build the height range of every node
+	HeightRanges.SetNum(NumLevels);
+	for (uint32 level = 0; level < NumLevels; ++level)
+	{
+		int32 span = 1 << level;
+		HeightRanges[level].SetNumZeroed(((XWidth + span - 1) / span) * ((YWidth + span - 1) / span));
+	}
+	for (int32 y = 0; y < YWidth; ++y)
+	{
+		for (int32 x = 0; x < XWidth; ++x)
+		{
+			UpdateHeightRanges(x, y);
+		}
+	}
+
+	// Get the material from the parent or use the engine default
+	Material = Component->GetMaterial(0);
+	if (Material == nullptr)
+	{
+		Material = UMaterial::GetDefaultMaterial(MD_Surface);
+	}
+
+	// Initialize the proxy on the rendering thread
+	ENQUEUE_RENDER_COMMAND(FQuadtreeFillBuffers)([this](FRHICommandListImmediate& RHICmdList) {
+		Initialize();
+		});
+}
+
+FTerrainQuadtreeSceneProxy::~FTerrainQuadtreeSceneProxy()
+{
+	// Remove the proxy from the memory stats, the texture and buffers are only counted once they have been created
+	if (HeightmapTexture.IsValid())
+	{
+		DEC_MEMORY_STAT_BY(STAT_DynamicTerrain_QuadtreeTextureMemory, GetTextureSize());
+		DEC_MEMORY_STAT_BY(STAT_DynamicTerrain_QuadtreeBufferMemory, GetPatchBufferSize());
+		DEC_MEMORY_STAT_BY(STAT_DynamicTerrain_QuadtreeMapMemory, GetMapSize());
+	}
+
+	VertexBuffer.ReleaseResource();
+	IndexBuffer.ReleaseResource();
+	VertexFactory.ReleaseResource();
+	HeightmapTexture.SafeRelease();
+}
+
+/// Scene Proxy Interface ///
+
+uint32 FTerrainQuadtreeSceneProxy::GetAllocatedSize() const
+{
+	return FPrimitiveSceneProxy::GetAllocatedSize() + GetTextureSize() + GetPatchBufferSize() + GetMapSize();
+}
+
+void FTerrainQuadtreeSceneProxy::GetDynamicMeshElements(const TArray< const FSceneView* >& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, class FMeshElementCollector& Collector) const
+{
+	// Check to see if wireframe rendering is enabled
+	const bool wireframe = AllowDebugViewmodes() && ViewFamily.EngineShowFlags.Wireframe;
+
+	// Get the material proxy from either the current material or the wireframe material
+	FMaterialRenderProxy* material_proxy = nullptr;
+	if (wireframe)
+	{
+		// Get the wireframe material
+		FColoredMaterialRenderProxy* wireframe_material = new FColoredMaterialRenderProxy(GEngine->WireframeMaterial ? GEngine->WireframeMaterial->GetRenderProxy() : nullptr, FLinearColor(0.0f, 0.5f, 1.0f));
+		Collector.RegisterOneFrameMaterialProxy(wireframe_material);
+
+		material_proxy = wireframe_material;
+	}
+	else
+	{
+		material_proxy = Material->GetRenderProxy();
+	}
+
+	int32 polygons = GetTerrainComponentWidth(Size) - 1;
+	for (int32 view_index = 0; view_index < Views.Num(); ++view_index)
+	{
+		if (VisibilityMap & (1 << view_index))
+		{
+			const FSceneView* view = Views[view_index];
+
+			// Walk the quadtree from the root
+			TArray<FNode> nodes;
+			{
+				SCOPE_CYCLE_COUNTER(STAT_DynamicTerrain_QuadtreeSelection);
+				SelectNodes(0, 0, NumLevels - 1, *view, nodes);
+			}
+			INC_DWORD_STAT_BY(STAT_DynamicTerrain_QuadtreeNodes, nodes.Num());
+
+			// Load uniform buffers
+			bool bHasPrecomputedVolumetricLightmap;
+			FMatrix PreviousLocalToWorld;
+			int32 SingleCaptureIndex;
+			bool bOutputVelocity;
+			GetScene().GetPrimitiveUniformShaderParameters_RenderThread(GetPrimitiveSceneInfo(), bHasPrecomputedVolumetricLightmap, PreviousLocalToWorld, SingleCaptureIndex, bOutputVelocity);
+
+			FDynamicPrimitiveUniformBuffer& DynamicPrimitiveUniformBuffer = Collector.AllocateOneFrameResource<FDynamicPrimitiveUniformBuffer>();
+			DynamicPrimitiveUniformBuffer.Set(GetLocalToWorld(), PreviousLocalToWorld, GetBounds(), GetLocalBounds(), true, bHasPrecomputedVolumetricLightmap, DrawsVelocity(), bOutputVelocity);
+
+			// Group the nodes by level, every level is drawn with a single instanced draw
+			TArray<TArray<FVector4>> level_nodes;
+			level_nodes.SetNum(NumLevels);
+			for (const FNode& node : nodes)
+			{
+				int32 span = 1 << node.Level;
+				level_nodes[node.Level].Add(FVector4(node.X * span * polygons, node.Y * span * polygons, span, 0.0f));
+			}
+
+			for (uint32 level = 0; level < NumLevels; ++level)
+			{
+				const TArray<FVector4>& instances = level_nodes[level];
+				if (instances.Num() == 0)
+				{
+					continue;
+				}
+
+				// Copy the nodes to the instance buffer for this frame
+				FGlobalDynamicVertexBuffer::FAllocation allocation = Collector.GetDynamicVertexBuffer().Allocate(instances.Num() * sizeof(FVector4));
+				FMemory::Memcpy(allocation.Buffer, instances.GetData(), instances.Num() * sizeof(FVector4));
+
+				// Set the morph range of the level
+				float range = GetLevelRange(level);
+				float morph_start = FMath::Lerp(level > 0 ? GetLevelRange(level - 1) : 0.0f, range, morph_start_ratio);
+
+				FTerrainBatchUserData& user_data = Collector.AllocateOneFrameResource<FTerrainBatchUserData>();
+				user_data.MorphParams = FVector4(morph_start, 1.0f / FMath::Max(range - morph_start, 1.0f), 0.0f, 0.0f);
+				user_data.InstanceBuffer = allocation.VertexBuffer;
+				user_data.InstanceOffset = allocation.VertexOffset;
+
+				// Set up the mesh
+				FMeshBatch& mesh = Collector.AllocateMesh();
+				mesh.bWireframe = wireframe;
+				mesh.VertexFactory = &VertexFactory;
+				mesh.MaterialRenderProxy = material_proxy;
+				mesh.ReverseCulling = IsLocalToWorldDeterminantNegative();
+				mesh.Type = PT_TriangleList;
+				mesh.DepthPriorityGroup = SDPG_World;
+				mesh.bCanApplyViewModeOverrides = false;
+
+				FMeshBatchElement& element = mesh.Elements[0];
+				element.IndexBuffer = &IndexBuffer;
+				element.FirstIndex = 0;
+				element.NumPrimitives = IndexBuffer.Indices.Num() / 3;
+				element.NumInstances = instances.Num();
+				element.MinVertexIndex = 0;
+				element.MaxVertexIndex = VertexBuffer.Positions.Num() - 1;
+				element.UserData = &user_data;
+				element.PrimitiveUniformBufferResource = &DynamicPrimitiveUniformBuffer.UniformBuffer;
+
+				// Add the mesh
+				Collector.AddMesh(view_index, mesh);
+				INC_DWORD_STAT(STAT_DynamicTerrain_QuadtreeDraws);
+			}
+		}
+	}
+
+	// Draw bounds in debug builds
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+	for (int32 view_index = 0; view_index < Views.Num(); ++view_index)
+	{
+		if (VisibilityMap & (1 << view_index))
+		{
+			// Render the object bounds
+			RenderBounds(Collector.GetPDI(view_index), ViewFamily.EngineShowFlags, GetBounds(), IsSelected());
+		}
+	}
+#endif
+}
+
+FPrimitiveViewRelevance FTerrainQuadtreeSceneProxy::GetViewRelevance(const FSceneView* View) const
+{
+	FPrimitiveViewRelevance Result;
+	Result.bDrawRelevance = IsShown(View);
+	Result.bShadowRelevance = IsShadowCast(View);
+
+	Result.bDynamicRelevance = true;
+
+	Result.bRenderInMainPass = ShouldRenderInMainPass();
+	Result.bUsesLightingChannels = GetLightingChannelMask() != GetDefaultLightingChannelMask();
+	Result.bRenderCustomDepth = ShouldRenderCustomDepth();
+
+	Result.bTranslucentSelfShadow = bCastVolumetricTranslucentShadow;
+	MaterialRelevance.SetPrimitiveViewRelevance(Result);
+	Result.bVelocityRelevance = IsMovable() && Result.bOpaque && Result.bRenderInMainPass;
+	return Result;
+}
+
+/// Proxy Update Functions ///
+
+void FTerrainQuadtreeSceneProxy::UpdateSection(int32 X, int32 Y, TSharedPtr<FMapSection, ESPMode::ThreadSafe> Section)
+{
+	int32 polygons = GetTerrainComponentWidth(Size) - 1;
+	int32 min_x = X * polygons;
+	int32 min_y = Y * polygons;
+	if (X < 0 || Y < 0 || X >= XWidth || Y >= YWidth || min_x + Section->X > Map->X || min_y + Section->Y > Map->Y)
+	{
+		return;
+	}
+
+	// Copy the section into the heightmap, borders included
+	for (int32 y = 0; y < Section->Y; ++y)
+	{
+		FMemory::Memcpy(&Map->Data[(min_y + y) * Map->X + min_x], &Section->Data[y * Section->X], Section->X * sizeof(float));
+	}
+	UpdateHeightRanges(X, Y);
+
+	// Copy the section to the texture
+	if (HeightmapTexture.IsValid())
+	{
+		FUpdateTextureRegion2D region(min_x, min_y, 0, 0, Section->X, Section->Y);
+		RHIUpdateTexture2D(HeightmapTexture, 0, region, Section->X * sizeof(float), (const uint8*)Section->Data.GetData());
+	}
+}
+
+void FTerrainQuadtreeSceneProxy::SetParameters(float NewTiling, float NewRangeScale)
+{
+	Tiling = NewTiling;
+	RangeScale = FMath::Max(NewRangeScale, min_range_scale);
+	VertexFactory.MapParams.Z = Tiling;
+}
+
+void FTerrainQuadtreeSceneProxy::Initialize()
+{
+	// Create the heightmap texture
+	FRHIResourceCreateInfo create_info;
+	HeightmapTexture = RHICreateTexture2D(Map->X, Map->Y, PF_R32_FLOAT, 1, 1, TexCreate_ShaderResource, create_info);
+	FUpdateTextureRegion2D region(0, 0, 0, 0, Map->X, Map->Y);
+	RHIUpdateTexture2D(HeightmapTexture, 0, region, Map->X * sizeof(float), (const uint8*)Map->Data.GetData());
+
+	// Initialize the buffers
+	VertexBuffer.InitResource();
+	IndexBuffer.InitResource();
+
+	// Initialize the vertex factory
+	int32 polygons = GetTerrainComponentWidth(Size) - 1;
+	VertexFactory.PositionBuffer = &VertexBuffer;
+	VertexFactory.Heightmap = HeightmapTexture;
+	VertexFactory.HeightmapSize = FVector4(Map->X, Map->Y, 1.0f / Map->X, 1.0f / Map->Y);
+	VertexFactory.MapParams = FVector4(-polygons * XWidth / 2.0f, -polygons * YWidth / 2.0f, Tiling, 0.0f);
+	VertexFactory.InitResource();
+
+	INC_MEMORY_STAT_BY(STAT_DynamicTerrain_QuadtreeTextureMemory, GetTextureSize());
+	INC_MEMORY_STAT_BY(STAT_DynamicTerrain_QuadtreeBufferMemory, GetPatchBufferSize());
+	INC_MEMORY_STAT_BY(STAT_DynamicTerrain_QuadtreeMapMemory, GetMapSize());
+}
+
+uint32 FTerrainQuadtreeSceneProxy::GetTextureSize() const
+{
+	// The heightmap is a single R32F mip, counted once it has been created on the rendering thread
+	return HeightmapTexture.IsValid() ? HeightmapTexture->GetSizeX() * HeightmapTexture->GetSizeY() * sizeof(float) : 0;
+}
+
+uint32 FTerrainQuadtreeSceneProxy::GetPatchBufferSize() const
+{
+	// The patch is kept on the CPU as well as in the GPU buffers
+	uint32 positions = VertexBuffer.Positions.Num() * sizeof(FVector2D);
+	uint32 indices = IndexBuffer.Indices.Num() * sizeof(uint32);
+	return VertexBuffer.Positions.GetAllocatedSize() + positions + IndexBuffer.Indices.GetAllocatedSize() + indices;
+}
+
+uint32 FTerrainQuadtreeSceneProxy::GetMapSize() const
+{
+	// The copy of the heightmap and the height range of every node
+	uint32 size = HeightRanges.GetAllocatedSize();
+	for (const TArray<FVector2D>& level : HeightRanges)
+	{
+		size += level.GetAllocatedSize();
+	}
+	if (Map.IsValid())
+	{
+		size += sizeof(FMapSection) + Map->Data.GetAllocatedSize();
+	}
+
+	return size;
+}
+
+void FTerrainQuadtreeSceneProxy::UpdateHeightRanges(int32 X, int32 Y)
+{
+	// Find the height range of the component
+	int32 width = GetTerrainComponentWidth(Size);
+	int32 polygons = width - 1;
+	FVector2D range(MAX_flt, -MAX_flt);
+	for (int32 y = 0; y < width; ++y)
+	{
+		for (int32 x = 0; x < width; ++x)
+		{
+			float height = Map->Data[(Y * polygons + y + 1) * Map->X + X * polygons + x + 1];
+			range.X = FMath::Min(range.X, height);
+			range.Y = FMath::Max(range.Y, height);
+		}
+	}
+	HeightRanges[0][Y * XWidth + X] = range;
+
+	// Merge the children of each node above the component
+	for (uint32 level = 1; level < NumLevels; ++level)
+	{
+		X /= 2;
+		Y /= 2;
+
+		int32 child_span = 1 << (level - 1);
+		int32 child_width = (XWidth + child_span - 1) / child_span;
+		int32 child_height = (YWidth + child_span - 1) / child_span;
+		int32 level_width = (XWidth + child_span * 2 - 1) / (child_span * 2);
+
+		range = FVector2D(MAX_flt, -MAX_flt);
+		for (int32 child = 0; child < 4; ++child)
+		{
+			int32 child_x = X * 2 + (child & 1);
+			int32 child_y = Y * 2 + (child >> 1);
+			if (child_x < child_width && child_y < child_height)
+			{
+				const FVector2D& child_range = HeightRanges[level - 1][child_y * child_width + child_x];
+				range.X = FMath::Min(range.X, child_range.X);
+				range.Y = FMath::Max(range.Y, child_range.Y);
+			}
+		}
+		HeightRanges[level][Y * level_width + X] = range;
+	}
+}
+
+FBox FTerrainQuadtreeSceneProxy::GetNodeBox(int32 X, int32 Y, uint32 Level) const
+{
+	int32 polygons = GetTerrainComponentWidth(Size) - 1;
+	int32 span = 1 << Level;
+	int32 level_width = (XWidth + span - 1) / span;
+	const FVector2D& range = HeightRanges[Level][Y * level_width + X];
+
+	// Clamp the node to the edge of the terrain
+	float offset_x = -polygons * XWidth / 2.0f;
+	float offset_y = -polygons * YWidth / 2.0f;
+	FVector min(offset_x + X * span * polygons, offset_y + Y * span * polygons, range.X);
+	FVector max(offset_x + FMath::Min((X + 1) * span, XWidth) * polygons, offset_y + FMath::Min((Y + 1) * span, YWidth) * polygons, range.Y);
+
+	return FBox(min, max);
+}
+
+float FTerrainQuadtreeSceneProxy::GetLevelRange(uint32 Level) const
+{
+	// Ranges double with each level along with the width of the nodes
+	FVector scale = GetLocalToWorld().GetScaleVector();
+	float node_width = (GetTerrainComponentWidth(Size) - 1) * (1 << Level) * FMath::Max(FMath::Abs(scale.X), FMath::Abs(scale.Y));
+
+	return node_width * RangeScale;
+}
+
+void FTerrainQuadtreeSceneProxy::SelectNodes(int32 X, int32 Y, uint32 Level, const FSceneView& View, TArray<FNode>& OutNodes) const
+{
+	int32 span = 1 << Level;
+	if (X * span >= XWidth || Y * span >= YWidth)
+	{
+		return;
+	}
+
+	// Skip nodes outside of the view, shadow depth passes cull against the frustum of the light instead
+	// The shadow frustum is in the translated space of the shadow, LOD ranges still follow the camera
+	FBox box = GetNodeBox(X, Y, Level).TransformBy(GetLocalToWorld());
+	const FConvexVolume* shadow_frustum = View.GetDynamicMeshElementsShadowCullFrustum();
+	bool visible = shadow_frustum
+		? shadow_frustum->IntersectBox(box.GetCenter() + View.GetPreShadowTranslation(), box.GetExtent())
+		: View.ViewFrustum.IntersectBox(box.GetCenter(), box.GetExtent());
+	if (!visible)
+	{
+		return;
+	}
+
+	// Split nodes that hang over the edge of the terrain or are close enough to need the next level
+	// Children outside of their own range are fully morphed, so they match the resolution of this node
+	bool partial = (X + 1) * span > XWidth || (Y + 1) * span > YWidth;
+	if (Level > 0 && (partial || box.ComputeSquaredDistanceToPoint(View.ViewMatrices.GetViewOrigin()) < FMath::Square(GetLevelRange(Level - 1))))
+	{
+		for (int32 child = 0; child < 4; ++child)
+		{
+			SelectNodes(X * 2 + (child & 1), Y * 2 + (child >> 1), Level - 1, View, OutNodes);
+		}
+		return;
+	}
+
+	FNode node;
+	node.X = X;
+	node.Y = Y;
+	node.Level = Level;
+	OutNodes.Add(node);
+}
\ No newline at end of file
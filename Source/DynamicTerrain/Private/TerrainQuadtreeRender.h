@@ -0,0 +1,152 @@
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PrimitiveSceneProxy.h"
+#include "VertexFactory.h"
+
+#include "DynamicMeshBuilder.h"
+
+class UTerrainQuadtreeComponent;
+struct FMapSection;
+
+// A vertex factory which places a shared patch on the heightmap texture for each quadtree node
+// Nodes are drawn as instances of the patch, each instance reads its node from an instance stream
+class FTerrainVertexFactory : public FVertexFactory
+{
+	DECLARE_VERTEX_FACTORY_TYPE(FTerrainVertexFactory);
+
+public:
+	FTerrainVertexFactory(ERHIFeatureLevel::Type InFeatureLevel);
+
+	static bool ShouldCompilePermutation(const FVertexFactoryShaderPermutationParameters& Parameters);
+	static void ModifyCompilationEnvironment(const FVertexFactoryShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment);
+
+	virtual void InitRHI() override;
+
+	// The vertex buffer containing the grid positions of the patch
+	const FVertexBuffer* PositionBuffer = nullptr;
+	// The index of the per-instance node stream, the buffer is provided by each mesh batch
+	int32 InstanceStreamIndex = -1;
+	// The heights of the terrain
+	FRHITexture* Heightmap = nullptr;
+	// xy = the size of the heightmap, zw = 1 / size
+	FVector4 HeightmapSize;
+	// xy = the local position of heightmap vertex (0, 0), z = UV tiling
+	FVector4 MapParams;
+};
+
+// Shader parameters of the nodes of a single level, referenced by a mesh batch element for the current frame
+struct FTerrainBatchUserData : public FOneFrameResource
+{
+	// x = the distance where morphing starts, y = 1 / the length of the morph range
+	FVector4 MorphParams;
+	// The buffer holding one node per instance
+	// xy = the heightmap vertex at the corner of the node, z = heightmap vertices per patch step
+	const FVertexBuffer* InstanceBuffer = nullptr;
+	uint32 InstanceOffset = 0;
+};
+
+// A vertex buffer holding the grid positions of a patch
+class FTerrainPatchVertexBuffer : public FVertexBuffer
+{
+public:
+	virtual void InitRHI() override;
+
+	// The grid position of each vertex
+	TArray<FVector2D> Positions;
+};
+
+// A rendering proxy which draws a whole terrain as a quadtree of patches
+// Functions for the proxy should only be called on the rendering thread (with the exception of the constructor)
+// Use functions in UTerrainQuadtreeComponent to change proxies on the game thread
+class FTerrainQuadtreeSceneProxy : public FPrimitiveSceneProxy
+{
+public:
+	FTerrainQuadtreeSceneProxy(UTerrainQuadtreeComponent* Component, TSharedPtr<FMapSection, ESPMode::ThreadSafe> MapData);
+	virtual ~FTerrainQuadtreeSceneProxy();
+
+	/// Scene Proxy Interface ///
+
+	SIZE_T GetTypeHash() const override
+	{
+		static size_t unique_pointer;
+		return reinterpret_cast<size_t>(&unique_pointer);
+	}
+
+	virtual uint32 GetMemoryFootprint() const override
+	{
+		return (sizeof(*this) + GetAllocatedSize());
+	}
+
+	uint32 GetAllocatedSize() const;
+
+	virtual bool CanBeOccluded() const override
+	{
+		return !MaterialRelevance.bDisableDepthTest;
+	}
+
+	virtual void GetDynamicMeshElements(const TArray< const FSceneView* >& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, class FMeshElementCollector& Collector) const override;
+	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const override;
+
+	/// Proxy Update Functions ///
+
+	// Copy the heights of a terrain component section into the heightmap
+	void UpdateSection(int32 X, int32 Y, TSharedPtr<FMapSection, ESPMode::ThreadSafe> Section);
+	// Change the UV tiling and level ranges without rebuilding the proxy
+	void SetParameters(float NewTiling, float NewRangeScale);
+
+protected:
+	// A node of the quadtree, level 0 nodes cover a single terrain component
+	struct FNode
+	{
+		int32 X;
+		int32 Y;
+		uint32 Level;
+	};
+
+	// Initialize buffers and the heightmap texture
+	void Initialize();
+	// Get the size of the heightmap texture
+	uint32 GetTextureSize() const;
+	// Get the size of the patch vertices and indices on the CPU and GPU
+	uint32 GetPatchBufferSize() const;
+	// Get the size of the heightmap copy and the height ranges of the nodes
+	uint32 GetMapSize() const;
+	// Recalculate the height range of a terrain component and every node above it
+	void UpdateHeightRanges(int32 X, int32 Y);
+	// Get the local bounds of a node
+	FBox GetNodeBox(int32 X, int32 Y, uint32 Level) const;
+	// Get the distance from the camera where a level ends
+	float GetLevelRange(uint32 Level) const;
+	// Add the nodes under a node that should be drawn in a view
+	void SelectNodes(int32 X, int32 Y, uint32 Level, const FSceneView& View, TArray<FNode>& OutNodes) const;
+
+	// A copy of the heightmap of the terrain
+	TSharedPtr<FMapSection, ESPMode::ThreadSafe> Map;
+	// The size of each terrain component
+	uint32 Size;
+	// The number of terrain components on each axis
+	int32 XWidth;
+	int32 YWidth;
+	// The UV Tiling of the terrain
+	float Tiling;
+	// The range of each level, measured in node widths
+	float RangeScale;
+	// The number of levels in the quadtree, the last level has a single node covering the whole terrain
+	uint32 NumLevels;
+	// The lowest and highest height of each node, for each level
+	TArray<TArray<FVector2D>> HeightRanges;
+
+	// The heightmap texture sampled by the vertex factory
+	FTexture2DRHIRef HeightmapTexture;
+	// The grid of vertices drawn for every node
+	FTerrainPatchVertexBuffer VertexBuffer;
+	// The triangles of the patch
+	FDynamicMeshIndexBuffer32 IndexBuffer;
+	// The vertex factory for placing patches
+	FTerrainVertexFactory VertexFactory;
+
+	// The material used to render the terrain
+	UMaterialInterface* Material;
+	FMaterialRelevance MaterialRelevance;
+};
\ No newline at end of file
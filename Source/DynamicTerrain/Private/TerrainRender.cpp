@@ -1,24 +1,93 @@
 #include "TerrainRender.h"
 #include "TerrainComponent.h"
+#include "TerrainTopology.h"
+#include "TerrainLODGrid.h"
+#include "TerrainUploadQueue.h"
+#include "TerrainStat.h"
 #include "Terrain.h"
 
 #include "Engine.h"
 #include "Materials/Material.h"
 
+DECLARE_CYCLE_STAT(TEXT("Dynamic Terrain - Prepare Vertex Data"), STAT_DynamicTerrain_PrepareVertexData, STATGROUP_DynamicTerrain);
+DECLARE_CYCLE_STAT(TEXT("Dynamic Terrain - Wait For Vertex Data"), STAT_DynamicTerrain_WaitForVertexData, STATGROUP_DynamicTerrain);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dynamic Terrain - Vertex Buffer Locks"), STAT_DynamicTerrain_VertexBufferLocks, STATGROUP_DynamicTerrain);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dynamic Terrain - Vertex Bytes Uploaded per Frame"), STAT_DynamicTerrain_VertexBytesUploaded, STATGROUP_DynamicTerrain);
+DECLARE_MEMORY_STAT(TEXT("Dynamic Terrain - Vertex Buffer Memory (GPU)"), STAT_DynamicTerrain_VertexBufferMemory, STATGROUP_DynamicTerrain);
+DECLARE_MEMORY_STAT(TEXT("Dynamic Terrain - Vertex Data Memory (CPU)"), STAT_DynamicTerrain_VertexDataMemory, STATGROUP_DynamicTerrain);
+DECLARE_MEMORY_STAT(TEXT("Dynamic Terrain - Index Buffer Memory"), STAT_DynamicTerrain_IndexBufferMemory, STATGROUP_DynamicTerrain);
+DECLARE_MEMORY_STAT(TEXT("Dynamic Terrain - Proxy Map Section Memory"), STAT_DynamicTerrain_ProxyMapMemory, STATGROUP_DynamicTerrain);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dynamic Terrain - Components Horizon Culled"), STAT_DynamicTerrain_HorizonCulled, STATGROUP_DynamicTerrain);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dynamic Terrain - Main Pass Triangles"), STAT_DynamicTerrain_MainTriangles, STATGROUP_DynamicTerrain);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dynamic Terrain - Shadow Pass Triangles"), STAT_DynamicTerrain_ShadowTriangles, STATGROUP_DynamicTerrain);
+
+// Copy CPU vertex data into a vertex buffer, returns the number of bytes uploaded
+static uint32 UploadVertexData(FRHIVertexBuffer* Buffer, const void* Data, uint32 Size)
+{
+	void* vertex_data = RHILockVertexBuffer(Buffer, 0, Size, RLM_WriteOnly);
+	FMemory::Memcpy(vertex_data, Data, Size);
+	RHIUnlockVertexBuffer(Buffer);
+
+	INC_DWORD_STAT(STAT_DynamicTerrain_VertexBufferLocks);
+	INC_DWORD_STAT_BY(STAT_DynamicTerrain_VertexBytesUploaded, Size);
+	return Size;
+}
+
+// An index buffer holding the interior and edge variants of a topology
+class FTerrainIndexBuffer : public FDynamicMeshIndexBuffer32
+{
+public:
+	virtual ~FTerrainIndexBuffer()
+	{
+		ReleaseResource();
+		DEC_MEMORY_STAT_BY(STAT_DynamicTerrain_IndexBufferMemory, Indices.GetAllocatedSize() + Indices.Num() * sizeof(uint32));
+	}
+
+	// Get the index buffer for a topology, creating it if no other proxy is using it
+	// Must be called on the rendering thread
+	static TSharedRef<FTerrainIndexBuffer> Get(const FTerrainTopology& Topology)
+	{
+		check(IsInRenderingThread());
+
+		static TMap<uint32, TWeakPtr<FTerrainIndexBuffer>> cache;
+		TWeakPtr<FTerrainIndexBuffer>* cached = cache.Find(Topology.GetSize());
+		if (cached != nullptr)
+		{
+			TSharedPtr<FTerrainIndexBuffer> buffer = cached->Pin();
+			if (buffer.IsValid())
+			{
+				return buffer.ToSharedRef();
+			}
+		}
+
+		TSharedRef<FTerrainIndexBuffer> buffer = MakeShareable(new FTerrainIndexBuffer());
+		buffer->Indices = Topology.GetIndices();
+		buffer->InitResource();
+
+		// The indices are kept on the CPU as well as the GPU
+		INC_MEMORY_STAT_BY(STAT_DynamicTerrain_IndexBufferMemory, buffer->Indices.GetAllocatedSize() + buffer->Indices.Num() * sizeof(uint32));
+		cache.Add(Topology.GetSize(), buffer);
+
+		return buffer;
+	}
+};
+
 FTerrainComponentSceneProxy::FTerrainComponentSceneProxy(UTerrainComponent* Component) : FPrimitiveSceneProxy(Component), VertexFactory(GetScene().GetFeatureLevel(), "FTerrainComponentSceneProxy"), MaterialRelevance(Component->GetMaterialRelevance(GetScene().GetFeatureLevel()))
 {
 	// Get map data from the parent component
-	MapProxy = Component->GetMapProxy();
+	SetMapSection(Component->GetMapProxy());
 	Size = Component->Size;
-	MaxLOD = Component->LODs;
-	
-	// Create LOD indices
+	Topology = FTerrainTopology::Get(Size);
+	MaxLOD = FMath::Clamp(Component->LODs, 1u, Topology->GetNumLODs());
 	ScaleLODs(Component->LODScale);
-	IndexBuffers.SetNum(MaxLOD);
-	for (uint32 i = 0; i < MaxLOD; ++i)
-	{
-		UpdateIndexData(IndexBuffers[i].Indices, i);
-	}
+	LODErrorThreshold = Component->LODErrorThreshold;
+	ShadowLODBias = FMath::Max(0, Component->ShadowLODBias);
+
+	// Get the neighbor grid from the parent component
+	GridX = Component->XOffset;
+	GridY = Component->YOffset;
+	LODGrid = Component->LODGrid;
+	UploadQueue = Component->UploadQueue;
 
 	// Get the material from the parent or use the engine default
 	Material = Component->GetMaterial(0);
@@ -27,29 +96,62 @@ FTerrainComponentSceneProxy::FTerrainComponentSceneProxy(UTerrainComponent* Comp
 		Material = UMaterial::GetDefaultMaterial(MD_Surface);
 	}
 
-	// Initialize the component on the rendering thread
-	uint32 width = GetTerrainComponentWidth(Size) - 1;
+	// Prepare vertex data on a worker thread, index data comes from the shared topology
 	int32 xoffset = Component->XOffset;
 	int32 yoffset = Component->YOffset;
 	float tiling = Component->Tiling;
-	ENQUEUE_RENDER_COMMAND(FComponentFillBuffers)([this, xoffset, yoffset, tiling](FRHICommandListImmediate& RHICmdList) {
-		Initialize(xoffset, yoffset, tiling);
-		});
+	PrepareTask = FFunctionGraphTask::CreateAndDispatchWhenReady([this, xoffset, yoffset, tiling]() {
+		PrepareVertexData(xoffset, yoffset, tiling);
+		}, GET_STATID(STAT_DynamicTerrain_PrepareVertexData), nullptr, ENamedThreads::AnyBackgroundThreadNormalTask);
 }
 
 FTerrainComponentSceneProxy::~FTerrainComponentSceneProxy()
 {
+	// The task writes to the proxy, so it has to finish even if the proxy never made it into the scene
+	WaitForVertexData();
+
 	VertexBuffers.PositionVertexBuffer.ReleaseResource();
 	VertexBuffers.StaticMeshVertexBuffer.ReleaseResource();
 	VertexFactory.ReleaseResource();
-	for (int32 i = 0; i < IndexBuffers.Num(); ++i)
+
+	// Remove the proxy from the memory stats
+	DEC_MEMORY_STAT_BY(STAT_DynamicTerrain_VertexBufferMemory, VertexResourceSize);
+	DEC_MEMORY_STAT_BY(STAT_DynamicTerrain_VertexDataMemory, GetVertexDataSize());
+	SetMapSection(nullptr);
+
+	if (LODGrid.IsValid())
+	{
+		LODGrid->ClearCell(GridX, GridY, this);
+	}
+
+	// Drop updates that were queued for this proxy but not uploaded yet
+	if (UploadQueue.IsValid())
 	{
-		IndexBuffers[i].ReleaseResource();
+		UploadQueue->RemoveProxy(this);
 	}
 }
 
 /// Scene Proxy Interface ///
 
+uint32 FTerrainComponentSceneProxy::GetAllocatedSize() const
+{
+	uint32 size = FPrimitiveSceneProxy::GetAllocatedSize();
+
+	// CPU copies of the vertex data and the GPU buffers created from them
+	size += GetVertexDataSize() + VertexResourceSize;
+
+	// The map section retained for updates and LOD errors
+	if (MapProxy.IsValid())
+	{
+		size += sizeof(FMapSection) + MapProxy->Data.GetAllocatedSize();
+	}
+
+	// LOD selection data
+	size += LODScales.GetAllocatedSize() + LODErrors.GetAllocatedSize();
+
+	return size;
+}
+
 void FTerrainComponentSceneProxy::GetDynamicMeshElements(const TArray< const FSceneView* >& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, class FMeshElementCollector& Collector) const
 {
 	// Check to see if wireframe rendering is enabled
@@ -77,24 +179,33 @@ void FTerrainComponentSceneProxy::GetDynamicMeshElements(const TArray< const FSc
 		{
 			const FSceneView* view = Views[view_index];
 
-			// Get the LOD index of the mesh
-			const FSceneView& lod_view = GetLODView(*view);
-			const FBoxSphereBounds bounds = GetBounds();
+			// Shadow depth passes gather meshes with the main view and a shadow cull frustum
+			const bool shadow = view->GetDynamicMeshElementsShadowCullFrustum() != nullptr;
 
-			FCachedSystemScalabilityCVars cvars = GetCachedScalabilityCVars();
-			float screen_scale = cvars.StaticMeshLODDistanceScale != 0.0f ? 1.0f / cvars.StaticMeshLODDistanceScale : 1.0f;
+			// Skip components hidden behind nearer terrain, shadow casters are kept since the light may still see them
+			if (LODGrid.IsValid() && view->IsPerspectiveProjection() && !shadow
+				&& LODGrid->IsHorizonOccluded(GridX, GridY, view->ViewMatrices.GetViewOrigin(), ViewFamily.FrameNumber))
+			{
+				INC_DWORD_STAT(STAT_DynamicTerrain_HorizonCulled);
+				continue;
+			}
 
-			uint32 LOD = 0;
-			float radius = ComputeBoundsScreenRadiusSquared(bounds.Origin, bounds.SphereRadius, *view) * screen_scale * screen_scale * lod_view.LODDistanceFactorSquared;
-			for (uint32 i = 0; i < MaxLOD; ++i)
+			// Get the LOD of the mesh and its neighbors, shadows use coarser LODs on both sides of each edge
+			const uint32 lod_bias = shadow ? ShadowLODBias : 0;
+			uint32 LOD = FMath::Min(GetLOD(GetBounds(), LODErrors, *view) + lod_bias, MaxLOD - 1);
+			static const FIntPoint neighbor_offsets[terrain_num_edges] = { FIntPoint(0, -1), FIntPoint(1, 0), FIntPoint(0, 1), FIntPoint(-1, 0) };
+			uint32 neighbor_lods[terrain_num_edges];
+			for (uint32 edge = 0; edge < terrain_num_edges; ++edge)
 			{
-				if (FMath::Square(LODScales[i] * 0.5) > radius)
+				// Edges without a neighbor don't need to be stitched
+				FTerrainLODCell neighbor;
+				if (LODGrid.IsValid() && LODGrid->GetCell(GridX + neighbor_offsets[edge].X, GridY + neighbor_offsets[edge].Y, neighbor))
 				{
-					LOD = i;
+					neighbor_lods[edge] = FMath::Min(GetLOD(neighbor.Bounds, neighbor.LODErrors, *view) + lod_bias, MaxLOD - 1);
 				}
 				else
 				{
-					break;
+					neighbor_lods[edge] = LOD;
 				}
 			}
 
@@ -108,13 +219,13 @@ void FTerrainComponentSceneProxy::GetDynamicMeshElements(const TArray< const FSc
 			mesh.DepthPriorityGroup = SDPG_World;
 			mesh.bCanApplyViewModeOverrides = false;
 
-			// Set up the first element of the mesh (we only need one)
-			FMeshBatchElement& element = mesh.Elements[0];
-			element.IndexBuffer = &IndexBuffers[LOD];
-			element.FirstIndex = 0;
-			element.NumPrimitives = IndexBuffers[LOD].Indices.Num() / 3;
-			element.MinVertexIndex = 0;
-			element.MaxVertexIndex = VertexBuffers.PositionVertexBuffer.GetNumVertices() - 1;
+			// Collect the interior and the edge strips that match the neighbors
+			FTerrainIndexRange ranges[terrain_num_edges + 1];
+			ranges[0] = Topology->GetInteriorRange(LOD);
+			for (uint32 edge = 0; edge < terrain_num_edges; ++edge)
+			{
+				ranges[edge + 1] = Topology->GetEdgeRange(LOD, edge, neighbor_lods[edge]);
+			}
 
 			// Load uniform buffers
 			bool bHasPrecomputedVolumetricLightmap;
@@ -125,7 +236,33 @@ void FTerrainComponentSceneProxy::GetDynamicMeshElements(const TArray< const FSc
 
 			FDynamicPrimitiveUniformBuffer& DynamicPrimitiveUniformBuffer = Collector.AllocateOneFrameResource<FDynamicPrimitiveUniformBuffer>();
 			DynamicPrimitiveUniformBuffer.Set(GetLocalToWorld(), PreviousLocalToWorld, GetBounds(), GetLocalBounds(), true, bHasPrecomputedVolumetricLightmap, DrawsVelocity(), bOutputVelocity);
-			element.PrimitiveUniformBufferResource = &DynamicPrimitiveUniformBuffer.UniformBuffer;
+
+			// Add an element for each range, all of them share the same buffers
+			mesh.Elements.Empty(terrain_num_edges + 1);
+			uint32 num_triangles = 0;
+			for (const FTerrainIndexRange& range : ranges)
+			{
+				if (range.NumIndices > 0)
+				{
+					FMeshBatchElement& element = mesh.Elements.AddDefaulted_GetRef();
+					element.IndexBuffer = IndexBuffer.Get();
+					element.FirstIndex = range.FirstIndex;
+					element.NumPrimitives = range.NumIndices / 3;
+					element.MinVertexIndex = 0;
+					element.MaxVertexIndex = VertexBuffers.PositionVertexBuffer.GetNumVertices() - 1;
+					element.PrimitiveUniformBufferResource = &DynamicPrimitiveUniformBuffer.UniformBuffer;
+					num_triangles += element.NumPrimitives;
+				}
+			}
+
+			if (shadow)
+			{
+				INC_DWORD_STAT_BY(STAT_DynamicTerrain_ShadowTriangles, num_triangles);
+			}
+			else
+			{
+				INC_DWORD_STAT_BY(STAT_DynamicTerrain_MainTriangles, num_triangles);
+			}
 
 			// Add the mesh
 			Collector.AddMesh(view_index, mesh);
@@ -163,24 +300,74 @@ FPrimitiveViewRelevance FTerrainComponentSceneProxy::GetViewRelevance(const FSce
 	return Result;
 }
 
-void FTerrainComponentSceneProxy::Initialize(int32 X, int32 Y, float Tiling)
+void FTerrainComponentSceneProxy::OnTransformChanged()
+{
+	// The first transform is set before resources are created, while the errors may still be written by the vertex data task
+	WaitForVertexData();
+
+	// Share the new bounds and errors with neighboring proxies
+	UpdateLODCell();
+}
+
+void FTerrainComponentSceneProxy::CreateRenderThreadResources()
+{
+	// The data is usually ready by now since it was prepared while the proxy was being added to the scene
+	WaitForVertexData();
+	InitializeResources();
+
+	// Share the cell in case no transform was set before resources were created
+	UpdateLODCell();
+}
+
+void FTerrainComponentSceneProxy::UpdateLODCell()
+{
+	if (LODGrid.IsValid())
+	{
+		FTerrainLODCell cell;
+		cell.Bounds = GetBounds();
+		cell.LODErrors = LODErrors;
+
+		// Only upright components fill their bounds' footprint, other transforms would let rays pass beside the surface
+		FVector z_axis = GetLocalToWorld().GetUnitAxis(EAxis::Z);
+		FVector x_axis = GetLocalToWorld().GetUnitAxis(EAxis::X);
+		cell.bOccluder = z_axis.Z > 1.0f - KINDA_SMALL_NUMBER && (FMath::Abs(x_axis.X) > 1.0f - KINDA_SMALL_NUMBER || FMath::Abs(x_axis.Y) > 1.0f - KINDA_SMALL_NUMBER);
+		LODGrid->SetCell(GridX, GridY, cell, this);
+	}
+}
+
+void FTerrainComponentSceneProxy::PrepareVertexData(int32 X, int32 Y, float Tiling)
 {
+	SCOPE_CYCLE_COUNTER(STAT_DynamicTerrain_PrepareVertexData);
+
 	// Initialize buffers
 	uint32 width = GetTerrainComponentWidth(Size);
 	VertexBuffers.PositionVertexBuffer.Init(width * width);
 	VertexBuffers.StaticMeshVertexBuffer.Init(width * width, 1);
+	INC_MEMORY_STAT_BY(STAT_DynamicTerrain_VertexDataMemory, GetVertexDataSize());
 
 	// Load data for all buffers
 	UpdateMapData();
 	UpdateUVData(X, Y, Tiling);
+}
 
-	// Initialize the buffers
-	for (int32 i = 0; i < IndexBuffers.Num(); ++i)
+void FTerrainComponentSceneProxy::WaitForVertexData()
+{
+	if (PrepareTask.IsValid())
 	{
-		IndexBuffers[i].InitResource();
+		SCOPE_CYCLE_COUNTER(STAT_DynamicTerrain_WaitForVertexData);
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(PrepareTask);
+		PrepareTask = nullptr;
 	}
+}
+
+void FTerrainComponentSceneProxy::InitializeResources()
+{
+	// Initialize the buffers
+	IndexBuffer = FTerrainIndexBuffer::Get(*Topology);
 	VertexBuffers.PositionVertexBuffer.InitResource();
 	VertexBuffers.StaticMeshVertexBuffer.InitResource();
+	VertexResourceSize = GetVertexDataSize();
+	INC_MEMORY_STAT_BY(STAT_DynamicTerrain_VertexBufferMemory, VertexResourceSize);
 
 	// Bind vertex factory data
 	FLocalVertexFactory::FDataType datatype;
@@ -197,39 +384,55 @@ void FTerrainComponentSceneProxy::Initialize(int32 X, int32 Y, float Tiling)
 
 /// Proxy Update Functions ///
 
-void FTerrainComponentSceneProxy::UpdateMap(TSharedPtr<FMapSection, ESPMode::ThreadSafe> SectionProxy)
+uint32 FTerrainComponentSceneProxy::UpdateMap(TSharedPtr<FMapSection, ESPMode::ThreadSafe> SectionProxy)
 {
 	// Copy map data to buffers
-	MapProxy = SectionProxy;
+	WaitForVertexData();
+	SetMapSection(SectionProxy);
 	UpdateMapData();
 
 	// Copy buffers to RHI
+	uint32 bytes = 0;
 	{
 		auto& vertex_buffer = VertexBuffers.PositionVertexBuffer;
-		void* vertex_data = RHILockVertexBuffer(vertex_buffer.VertexBufferRHI, 0, vertex_buffer.GetNumVertices() * vertex_buffer.GetStride(), RLM_WriteOnly);
-		FMemory::Memcpy(vertex_data, vertex_buffer.GetVertexData(), vertex_buffer.GetNumVertices() * vertex_buffer.GetStride());
-		RHIUnlockVertexBuffer(vertex_buffer.VertexBufferRHI);
+		bytes += UploadVertexData(vertex_buffer.VertexBufferRHI, vertex_buffer.GetVertexData(), vertex_buffer.GetNumVertices() * vertex_buffer.GetStride());
 	}
 
 	{
 		auto& vertex_buffer = VertexBuffers.StaticMeshVertexBuffer;
-		void* vertex_data = RHILockVertexBuffer(vertex_buffer.TangentsVertexBuffer.VertexBufferRHI, 0, vertex_buffer.GetTangentSize(), RLM_WriteOnly);
-		FMemory::Memcpy(vertex_data, vertex_buffer.GetTangentData(), vertex_buffer.GetTangentSize());
-		RHIUnlockVertexBuffer(vertex_buffer.TangentsVertexBuffer.VertexBufferRHI);
+		bytes += UploadVertexData(vertex_buffer.TangentsVertexBuffer.VertexBufferRHI, vertex_buffer.GetTangentData(), vertex_buffer.GetTangentSize());
 	}
+
+	return bytes;
 }
 
-void FTerrainComponentSceneProxy::UpdateUVs(int32 XOffset, int32 YOffset, float Tiling)
+uint32 FTerrainComponentSceneProxy::UpdateUVs(int32 XOffset, int32 YOffset, float Tiling)
 {
 	// Set UV data
+	WaitForVertexData();
 	UpdateUVData(XOffset, YOffset, Tiling);
 
 	// Copy buffers to RHI
+	auto& vertex_buffer = VertexBuffers.StaticMeshVertexBuffer;
+	return UploadVertexData(vertex_buffer.TexCoordVertexBuffer.VertexBufferRHI, vertex_buffer.GetTexCoordData(), vertex_buffer.GetTexCoordSize());
+}
+
+uint32 FTerrainComponentSceneProxy::GetVertexDataSize() const
+{
+	return VertexBuffers.PositionVertexBuffer.GetNumVertices() * VertexBuffers.PositionVertexBuffer.GetStride() + VertexBuffers.StaticMeshVertexBuffer.GetResourceSize();
+}
+
+void FTerrainComponentSceneProxy::SetMapSection(TSharedPtr<FMapSection, ESPMode::ThreadSafe> Section)
+{
+	if (MapProxy.IsValid())
 	{
-		auto& vertex_buffer = VertexBuffers.StaticMeshVertexBuffer;
-		void* vertex_data = RHILockVertexBuffer(vertex_buffer.TexCoordVertexBuffer.VertexBufferRHI, 0, vertex_buffer.GetTexCoordSize(), RLM_WriteOnly);
-		FMemory::Memcpy(vertex_data, vertex_buffer.GetTexCoordData(), vertex_buffer.GetTexCoordSize());
-		RHIUnlockVertexBuffer(vertex_buffer.TexCoordVertexBuffer.VertexBufferRHI);
+		DEC_MEMORY_STAT_BY(STAT_DynamicTerrain_ProxyMapMemory, MapProxy->Data.GetAllocatedSize());
+	}
+
+	MapProxy = Section;
+	if (MapProxy.IsValid())
+	{
+		INC_MEMORY_STAT_BY(STAT_DynamicTerrain_ProxyMapMemory, MapProxy->Data.GetAllocatedSize());
 	}
 }
 
@@ -263,6 +466,9 @@ void FTerrainComponentSceneProxy::UpdateMapData()
 			VertexBuffers.StaticMeshVertexBuffer.SetVertexTangents(i, vx, vy, FVector::CrossProduct(vx, vy));
 		}
 	}
+
+	// Measure how much each LOD deviates from the new heights
+	UpdateLODErrors();
 }
 
 void FTerrainComponentSceneProxy::UpdateUVData(int32 XOffset, int32 YOffset, float Tiling)
@@ -280,38 +486,112 @@ void FTerrainComponentSceneProxy::UpdateUVData(int32 XOffset, int32 YOffset, flo
 	}
 }
 
-void FTerrainComponentSceneProxy::UpdateIndexData(TArray<uint32>& Indices, uint32 Stride)
+void FTerrainComponentSceneProxy::ScaleLODs(float Scale)
+{
+	LODScales.Empty();
+	LODScales.SetNumUninitialized(MaxLOD);
+
+	for (uint32 i = 0; i < MaxLOD; ++i)
+	{
+		LODScales[i] = FMath::Pow(Scale, i);
+	}
+}
+
+void FTerrainComponentSceneProxy::UpdateLODErrors()
 {
-	Stride = FMath::Exp2(Stride);
 	uint32 width = GetTerrainComponentWidth(Size);
-	uint32 polygons = (width - 1) / Stride;
+	auto height = [this](uint32 X, uint32 Y) { return MapProxy->Data[(Y + 1) * MapProxy->X + X + 1]; };
 
-	Indices.Empty();
-	Indices.SetNumUninitialized(polygons * polygons * 6);
-	for (uint32 y = 0; y < polygons; y++)
+	// Compare every vertex against the triangle of the coarser LOD that covers it
+	LODErrors.SetNumZeroed(MaxLOD);
+	for (uint32 lod = 1; lod < MaxLOD; ++lod)
 	{
-		for (uint32 x = 0; x < polygons; x++)
+		uint32 stride = 1 << lod;
+		float max_error = LODErrors[lod - 1];
+		for (uint32 y = 0; y < width; ++y)
 		{
-			uint32 i = (y * polygons + x) * 6;
-
-			Indices[i] = x * Stride + y * Stride * width;
-			Indices[i + 1] = (1 + x) * Stride + (y + 1) * Stride * width;
-			Indices[i + 2] = (1 + x) * Stride + y * Stride * width;
+			for (uint32 x = 0; x < width; ++x)
+			{
+				// Get the quad of the LOD containing the vertex
+				uint32 x0 = FMath::Min(x / stride * stride, width - 1 - stride);
+				uint32 y0 = FMath::Min(y / stride * stride, width - 1 - stride);
+				float u = (float)(x - x0) / stride;
+				float v = (float)(y - y0) / stride;
+
+				float h00 = height(x0, y0);
+				float h10 = height(x0 + stride, y0);
+				float h01 = height(x0, y0 + stride);
+				float h11 = height(x0 + stride, y0 + stride);
+
+				// Quads are split along the diagonal from (0, 0) to (1, 1)
+				float interpolated;
+				if (u >= v)
+				{
+					interpolated = h00 + u * (h10 - h00) + v * (h11 - h10);
+				}
+				else
+				{
+					interpolated = h00 + v * (h01 - h00) + u * (h11 - h01);
+				}
 
-			Indices[i + 3] = x * Stride + y * Stride * width;
-			Indices[i + 4] = x * Stride + (y + 1) * Stride * width;
-			Indices[i + 5] = (1 + x) * Stride + (y + 1) * Stride * width;
+				max_error = FMath::Max(max_error, FMath::Abs(height(x, y) - interpolated));
+			}
 		}
+
+		// Errors never decrease with coarser LODs so that selection can stop at the first LOD over the threshold
+		LODErrors[lod] = max_error;
 	}
 }
 
-void FTerrainComponentSceneProxy::ScaleLODs(float Scale)
+uint32 FTerrainComponentSceneProxy::GetLOD(const FBoxSphereBounds& ComponentBounds, TArrayView<const float> Errors, const FSceneView& View) const
 {
-	LODScales.Empty();
-	LODScales.SetNumUninitialized(MaxLOD);
+	const FSceneView& lod_view = GetLODView(View);
+
+	FCachedSystemScalabilityCVars cvars = GetCachedScalabilityCVars();
+	float screen_scale = cvars.StaticMeshLODDistanceScale != 0.0f ? 1.0f / cvars.StaticMeshLODDistanceScale : 1.0f;
+
+	uint32 LOD = 0;
+
+	// Pick the coarsest LOD whose projected error stays under the threshold
+	if (LODErrorThreshold > 0.0f && Errors.Num() > 0)
+	{
+		// Get the number of pixels covered by one world unit at a distance of one unit
+		const FMatrix& projection = View.ViewMatrices.GetProjectionMatrix();
+		float pixel_scale = FMath::Max(0.5f * View.UnscaledViewRect.Width() * projection.M[0][0], 0.5f * View.UnscaledViewRect.Height() * projection.M[1][1]);
+		float error_scale = FMath::Abs(GetLocalToWorld().GetScaleVector().Z) * pixel_scale * screen_scale * FMath::Sqrt(lod_view.LODDistanceFactorSquared);
 
+		// Errors shrink with the distance to the closest point of the component
+		if (View.ViewMatrices.IsPerspectiveProjection())
+		{
+			float distance = FMath::Sqrt(ComponentBounds.GetBox().ComputeSquaredDistanceToPoint(View.ViewMatrices.GetViewOrigin()));
+			error_scale /= FMath::Max(distance, 1.0f);
+		}
+
+		uint32 num_lods = FMath::Min(MaxLOD, (uint32)Errors.Num());
+		for (uint32 i = 1; i < num_lods; ++i)
+		{
+			if (Errors[i] * error_scale > LODErrorThreshold)
+			{
+				break;
+			}
+			LOD = i;
+		}
+
+		return LOD;
+	}
+
+	float radius = ComputeBoundsScreenRadiusSquared(ComponentBounds.Origin, ComponentBounds.SphereRadius, View) * screen_scale * screen_scale * lod_view.LODDistanceFactorSquared;
 	for (uint32 i = 0; i < MaxLOD; ++i)
 	{
-		LODScales[i] = FMath::Pow(Scale, i);
+		if (FMath::Square(LODScales[i] * 0.5) > radius)
+		{
+			LOD = i;
+		}
+		else
+		{
+			break;
+		}
 	}
+
+	return LOD;
 }
\ No newline at end of file
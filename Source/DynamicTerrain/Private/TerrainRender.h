@@ -4,12 +4,18 @@
 #include "PrimitiveSceneProxy.h"
 
 #include "DynamicMeshBuilder.h"
+#include "Async/TaskGraphInterfaces.h"
 
 class UTerrainComponent;
+class FTerrainTopology;
+class FTerrainLODGrid;
+class FTerrainIndexBuffer;
+class FTerrainUploadQueue;
 struct FMapSection;
 
 // A rendering proxy which stores rendering data for a single terrain component
 // Functions for the proxy should only be called on the rendering thread (with the exception of the constructor)
+// Vertex data is prepared on a worker thread started by the constructor and uploaded when the proxy is added to the scene
 // Use functions in UTerrainComponent to change proxies on the game thread
 class FTerrainComponentSceneProxy : public FPrimitiveSceneProxy
 {
@@ -30,10 +36,8 @@ public:
 		return (sizeof(*this) + GetAllocatedSize());
 	}
 
-	uint32 GetAllocatedSize() const
-	{
-		return(FPrimitiveSceneProxy::GetAllocatedSize());
-	}
+	// Get the memory owned by the proxy, index data and topology are shared between proxies and only show up in terrain stats
+	uint32 GetAllocatedSize() const;
 
 	virtual bool CanBeOccluded() const override
 	{
@@ -42,37 +46,66 @@ public:
 
 	virtual void GetDynamicMeshElements(const TArray< const FSceneView* >& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, class FMeshElementCollector& Collector) const override;
 	virtual FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const override;
+	virtual void OnTransformChanged() override;
+	virtual void CreateRenderThreadResources() override;
 
 	/// Proxy Update Functions ///
 
-	// Update rending data using the provided proxy
-	void UpdateMap(TSharedPtr<FMapSection, ESPMode::ThreadSafe> SectionProxy);
-	// Update UV tiling
-	void UpdateUVs(int32 XOffset, int32 YOffset, float Tiling);
+	// Update rending data using the provided proxy, returns the number of bytes uploaded
+	uint32 UpdateMap(TSharedPtr<FMapSection, ESPMode::ThreadSafe> SectionProxy);
+	// Update UV tiling, returns the number of bytes uploaded
+	uint32 UpdateUVs(int32 XOffset, int32 YOffset, float Tiling);
 
 protected:
-	// Initialize vertex buffers
-	void Initialize(int32 X, int32 Y, float Tiling);
+	// Fill the CPU copies of the vertex buffers, runs on a worker thread before the proxy is added to the scene
+	void PrepareVertexData(int32 X, int32 Y, float Tiling);
+	// Wait until the vertex data has been prepared
+	void WaitForVertexData();
+	// Create the RHI resources from the prepared vertex data
+	void InitializeResources();
+	// Share the bounds and errors of the component with neighboring proxies
+	void UpdateLODCell();
+	// Get the size of the vertex data, which is kept both on the GPU and as a CPU copy for updates
+	uint32 GetVertexDataSize() const;
+	// Keep the memory stat of the retained map section up to date
+	void SetMapSection(TSharedPtr<FMapSection, ESPMode::ThreadSafe> Section);
 	// Update rendering data using the current map proxy data
 	void UpdateMapData();
 	// Update mesh UVs using the provided offsets and tiling
 	void UpdateUVData(int32 XOffset, int32 YOffset, float Tiling);
-	// Fill index buffers
-	void UpdateIndexData(TArray<uint32>& Indices, uint32 Stride);
 	// Set LOD scales for each lod
 	void ScaleLODs(float Scale);
+	// Calculate the maximum vertical error of each LOD against full resolution
+	void UpdateLODErrors();
+	// Get the LOD a component with the given bounds and errors should use in a view
+	// Neighbors are evaluated with the same function so that both sides of an edge agree on its resolution
+	uint32 GetLOD(const FBoxSphereBounds& ComponentBounds, TArrayView<const float> Errors, const FSceneView& View) const;
 
 	// The heightmap data the component needs to render
 	TSharedPtr<FMapSection, ESPMode::ThreadSafe> MapProxy = nullptr;
 	// The width of the component, the number of vertices is Size * Size + 1
 	uint32 Size;
 
+	// The position of the component in the terrain
+	int32 GridX;
+	int32 GridY;
+	// The bounds of neighboring components
+	TSharedPtr<FTerrainLODGrid, ESPMode::ThreadSafe> LODGrid;
+	// The queue batching vertex updates of the terrain
+	TSharedPtr<FTerrainUploadQueue, ESPMode::ThreadSafe> UploadQueue;
+
 	// The vertex buffers containing mesh data
 	FStaticMeshVertexBuffers VertexBuffers;
-	// The triangles used by the component's mesh
-	TArray<FDynamicMeshIndexBuffer32> IndexBuffers;
+	// The triangle ranges of each LOD and edge variant
+	TSharedPtr<const FTerrainTopology, ESPMode::ThreadSafe> Topology;
+	// The triangles used by the component's mesh, shared with proxies of the same size
+	TSharedPtr<FTerrainIndexBuffer> IndexBuffer;
 	// The vertex factory for storing vertex type data
 	FLocalVertexFactory VertexFactory;
+	// Completes once the vertex data has been prepared
+	FGraphEventRef PrepareTask;
+	// The size of the vertex buffers created on the GPU, 0 until resources are initialized
+	uint32 VertexResourceSize = 0;
 
 	// The material used to render the component
 	UMaterialInterface* Material;
@@ -82,4 +115,10 @@ protected:
 	uint32 MaxLOD;
 	// LOD scales for each individual LOD
 	TArray<float> LODScales;
+	// The maximum vertical error of each LOD in local units
+	TArray<float, TInlineAllocator<8>> LODErrors;
+	// The screen space error in pixels allowed when selecting LODs, distance scaling is used when this is 0
+	float LODErrorThreshold;
+	// The number of coarser LODs used when drawing into shadow maps
+	uint32 ShadowLODBias;
 };
\ No newline at end of file
@@ -0,0 +1,263 @@
+#include "TerrainTopology.h"
+
+#include "TerrainStat.h"
+#include "Terrain.h"
+
+#include "Misc/ScopeLock.h"
+
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Dynamic Terrain - Topology ACMR"), STAT_DynamicTerrain_TopologyACMR, STATGROUP_DynamicTerrain);
+DECLARE_MEMORY_STAT(TEXT("Dynamic Terrain - Topology Memory"), STAT_DynamicTerrain_TopologyMemory, STATGROUP_DynamicTerrain);
+
+// The number of quads in each column strip, two rows of a strip fit in a 16 entry vertex cache
+constexpr uint32 terrain_strip_quads = 6;
+// The cache size used to report the ACMR of new topologies
+constexpr uint32 terrain_acmr_cache_size = 16;
+
+// Topologies that are currently in use, indexed by component size
+static TMap<uint32, TWeakPtr<const FTerrainTopology, ESPMode::ThreadSafe>> TopologyCache;
+// Guards access to the topology cache
+static FCriticalSection TopologyCacheLock;
+
+TSharedRef<const FTerrainTopology, ESPMode::ThreadSafe> FTerrainTopology::Get(uint32 Size)
+{
+	FScopeLock lock(&TopologyCacheLock);
+
+	// Reuse the topology if a component of the same size still holds it
+	TWeakPtr<const FTerrainTopology, ESPMode::ThreadSafe>* cached = TopologyCache.Find(Size);
+	if (cached != nullptr)
+	{
+		TSharedPtr<const FTerrainTopology, ESPMode::ThreadSafe> topology = cached->Pin();
+		if (topology.IsValid())
+		{
+			return topology.ToSharedRef();
+		}
+	}
+
+	TSharedRef<const FTerrainTopology, ESPMode::ThreadSafe> topology = MakeShareable(new FTerrainTopology(Size));
+	TopologyCache.Add(Size, topology);
+
+	return topology;
+}
+
+FTerrainTopology::~FTerrainTopology()
+{
+	DEC_MEMORY_STAT_BY(STAT_DynamicTerrain_TopologyMemory, GetAllocatedSize());
+}
+
+uint32 FTerrainTopology::GetSize() const
+{
+	return Size;
+}
+
+uint32 FTerrainTopology::GetWidth() const
+{
+	return Width;
+}
+
+uint32 FTerrainTopology::GetNumLODs() const
+{
+	return NumLODs;
+}
+
+const TArray<uint32>& FTerrainTopology::GetGridIndices() const
+{
+	return GridIndices;
+}
+
+const TArray<uint32>& FTerrainTopology::GetIndices() const
+{
+	return Indices;
+}
+
+FTerrainIndexRange FTerrainTopology::GetInteriorRange(uint32 LOD) const
+{
+	return InteriorRanges[FMath::Min(LOD, NumLODs - 1)];
+}
+
+FTerrainIndexRange FTerrainTopology::GetEdgeRange(uint32 LOD, uint32 Edge, uint32 NeighborLOD) const
+{
+	LOD = FMath::Min(LOD, NumLODs - 1);
+	NeighborLOD = FMath::Min(NeighborLOD, NumLODs - 1);
+	return EdgeRanges[(LOD * terrain_num_edges + Edge) * NumLODs + NeighborLOD];
+}
+
+SIZE_T FTerrainTopology::GetAllocatedSize() const
+{
+	return GridIndices.GetAllocatedSize() + Indices.GetAllocatedSize() + InteriorRanges.GetAllocatedSize() + EdgeRanges.GetAllocatedSize();
+}
+
+float FTerrainTopology::GetACMR(TArrayView<const uint32> TriangleIndices, uint32 CacheSize)
+{
+	if (TriangleIndices.Num() < 3 || CacheSize == 0)
+	{
+		return 0.0f;
+	}
+
+	// Simulate a FIFO cache, hits don't change the order of the entries
+	TArray<uint32> cache;
+	cache.Init(MAX_uint32, CacheSize);
+	uint32 next = 0;
+	uint32 misses = 0;
+	for (uint32 index : TriangleIndices)
+	{
+		if (!cache.Contains(index))
+		{
+			cache[next] = index;
+			next = (next + 1) % CacheSize;
+			++misses;
+		}
+	}
+
+	return (float)misses / (TriangleIndices.Num() / 3);
+}
+
+FTerrainTopology::FTerrainTopology(uint32 NewSize)
+{
+	Size = NewSize;
+	Width = GetTerrainComponentWidth(Size);
+
+	// Each LOD halves the resolution of the previous one, down to two quads across
+	NumLODs = FMath::Max(1u, Size);
+	CreateGridIndices(GridIndices, 0);
+
+	InteriorRanges.SetNum(NumLODs);
+	EdgeRanges.SetNum(NumLODs * terrain_num_edges * NumLODs);
+	for (uint32 lod = 0; lod < NumLODs; ++lod)
+	{
+		InteriorRanges[lod].FirstIndex = Indices.Num();
+		CreateInteriorIndices(lod);
+		InteriorRanges[lod].NumIndices = Indices.Num() - InteriorRanges[lod].FirstIndex;
+
+		for (uint32 edge = 0; edge < terrain_num_edges; ++edge)
+		{
+			FTerrainIndexRange* ranges = &EdgeRanges[(lod * terrain_num_edges + edge) * NumLODs];
+			for (uint32 neighbor = lod; neighbor < NumLODs; ++neighbor)
+			{
+				ranges[neighbor].FirstIndex = Indices.Num();
+				CreateEdgeIndices(lod, edge, neighbor);
+				ranges[neighbor].NumIndices = Indices.Num() - ranges[neighbor].FirstIndex;
+			}
+
+			// Finer neighbors stitch to this LOD, so their edges match the unstitched strip
+			for (uint32 neighbor = 0; neighbor < lod; ++neighbor)
+			{
+				ranges[neighbor] = ranges[lod];
+			}
+		}
+	}
+
+	INC_MEMORY_STAT_BY(STAT_DynamicTerrain_TopologyMemory, GetAllocatedSize());
+
+	// Report how well the full resolution interior uses the vertex cache
+	FTerrainIndexRange interior = InteriorRanges[0];
+	SET_FLOAT_STAT(STAT_DynamicTerrain_TopologyACMR, GetACMR(TArrayView<const uint32>(Indices.GetData() + interior.FirstIndex, interior.NumIndices), terrain_acmr_cache_size));
+}
+
+void FTerrainTopology::CreateGridIndices(TArray<uint32>& OutIndices, uint32 LOD)
+{
+	uint32 stride = FMath::Exp2(LOD);
+	uint32 polygons = (Width - 1) / stride;
+
+	OutIndices.Empty(polygons * polygons * 6);
+	AddQuads(OutIndices, stride, 0, polygons);
+}
+
+void FTerrainTopology::CreateInteriorIndices(uint32 LOD)
+{
+	uint32 stride = FMath::Exp2(LOD);
+	uint32 polygons = (Width - 1) / stride;
+
+	if (polygons > 2)
+	{
+		AddQuads(Indices, stride, 1, polygons - 1);
+	}
+}
+
+void FTerrainTopology::AddQuads(TArray<uint32>& OutIndices, uint32 Stride, uint32 Min, uint32 Max) const
+{
+	for (uint32 strip = Min; strip < Max; strip += terrain_strip_quads)
+	{
+		uint32 strip_end = FMath::Min(strip + terrain_strip_quads, Max);
+		for (uint32 y = Min; y < Max; y++)
+		{
+			for (uint32 x = strip; x < strip_end; x++)
+			{
+				OutIndices.Add(x * Stride + y * Stride * Width);
+				OutIndices.Add((1 + x) * Stride + (y + 1) * Stride * Width);
+				OutIndices.Add((1 + x) * Stride + y * Stride * Width);
+
+				OutIndices.Add(x * Stride + y * Stride * Width);
+				OutIndices.Add(x * Stride + (y + 1) * Stride * Width);
+				OutIndices.Add((1 + x) * Stride + (y + 1) * Stride * Width);
+			}
+		}
+	}
+}
+
+void FTerrainTopology::CreateEdgeIndices(uint32 LOD, uint32 Edge, uint32 NeighborLOD)
+{
+	int32 last = Width - 1;
+	int32 inner_stride = FMath::Exp2(LOD);
+	int32 outer_stride = FMath::Exp2(FMath::Max(LOD, NeighborLOD));
+
+	// Positions along the edge of the outer row and the row bordering the interior
+	TArray<int32> outer;
+	for (int32 t = 0; t <= last; t += outer_stride)
+	{
+		outer.Add(t);
+	}
+	TArray<int32> inner;
+	for (int32 t = inner_stride; t <= last - inner_stride; t += inner_stride)
+	{
+		inner.Add(t);
+	}
+
+	// Zip the two rows together, always advancing the row whose next vertex comes first along the edge
+	int32 o = 0;
+	int32 i = 0;
+	while (o + 1 < outer.Num() || i + 1 < inner.Num())
+	{
+		if (i + 1 >= inner.Num() || (o + 1 < outer.Num() && outer[o + 1] <= inner[i + 1]))
+		{
+			AddEdgeTriangle(Edge, FIntPoint(outer[o], 0), FIntPoint(outer[o + 1], 0), FIntPoint(inner[i], inner_stride));
+			++o;
+		}
+		else
+		{
+			AddEdgeTriangle(Edge, FIntPoint(outer[o], 0), FIntPoint(inner[i], inner_stride), FIntPoint(inner[i + 1], inner_stride));
+			++i;
+		}
+	}
+}
+
+void FTerrainTopology::AddEdgeTriangle(uint32 Edge, FIntPoint A, FIntPoint B, FIntPoint C)
+{
+	// Convert edge coordinates to vertex coordinates
+	int32 last = Width - 1;
+	FIntPoint points[3] = { A, B, C };
+	for (int32 i = 0; i < 3; ++i)
+	{
+		int32 t = points[i].X;
+		int32 d = points[i].Y;
+		switch (Edge)
+		{
+		case 0: points[i] = FIntPoint(t, d); break;
+		case 1: points[i] = FIntPoint(last - d, t); break;
+		case 2: points[i] = FIntPoint(t, last - d); break;
+		default: points[i] = FIntPoint(d, t); break;
+		}
+	}
+
+	// Match the winding of the grid triangles, which have a negative area in the XY plane
+	FIntPoint ab = points[1] - points[0];
+	FIntPoint ac = points[2] - points[0];
+	if (ab.X * ac.Y - ab.Y * ac.X > 0)
+	{
+		Swap(points[1], points[2]);
+	}
+
+	for (int32 i = 0; i < 3; ++i)
+	{
+		Indices.Add(points[i].Y * Width + points[i].X);
+	}
+}
\ No newline at end of file
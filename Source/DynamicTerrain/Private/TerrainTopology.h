@@ -0,0 +1,74 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+// The number of edges of a terrain component, edges are ordered -Y, +X, +Y, -X
+constexpr uint32 terrain_num_edges = 4;
+
+// A range of triangles in the shared index data of a topology
+struct FTerrainIndexRange
+{
+	uint32 FirstIndex = 0;
+	uint32 NumIndices = 0;
+};
+
+// Triangle indices shared by every terrain component of the same size
+// Each LOD is split into an interior and four edge strips, each edge strip has a variant for every neighbor LOD
+// so that adjacent components can use the same vertices along their shared edge
+// Topologies are immutable once created and can be read from any thread
+class FTerrainTopology
+{
+public:
+	// Get the shared topology for components of the given size
+	static TSharedRef<const FTerrainTopology, ESPMode::ThreadSafe> Get(uint32 Size);
+	~FTerrainTopology();
+
+	// Get the size the topology was created for
+	uint32 GetSize() const;
+	// Get the vertex width of the mesh
+	uint32 GetWidth() const;
+	// Get the number of LODs with index data
+	uint32 GetNumLODs() const;
+	// Get the full resolution triangle indices, used for collision and quadtree patches
+	const TArray<uint32>& GetGridIndices() const;
+	// Get the index data containing the interior and edge strips of every LOD
+	const TArray<uint32>& GetIndices() const;
+	// Get the range of the interior triangles of an LOD, LOD 0 is full resolution
+	FTerrainIndexRange GetInteriorRange(uint32 LOD) const;
+	// Get the range of an edge strip of an LOD which matches the vertices of a neighbor at NeighborLOD
+	FTerrainIndexRange GetEdgeRange(uint32 LOD, uint32 Edge, uint32 NeighborLOD) const;
+	// Get the memory used by the index data and ranges
+	SIZE_T GetAllocatedSize() const;
+
+	// Get the average number of vertices transformed per triangle with a FIFO post-transform cache of CacheSize entries
+	static float GetACMR(TArrayView<const uint32> TriangleIndices, uint32 CacheSize);
+
+private:
+	FTerrainTopology(uint32 Size);
+
+	// Fill an index buffer with every quad of an LOD
+	void CreateGridIndices(TArray<uint32>& OutIndices, uint32 LOD);
+	// Add the quads of an LOD that don't touch the edge of the component
+	void CreateInteriorIndices(uint32 LOD);
+	// Add the quads between Min and Max on both axes in narrow column strips, which keeps the shared row in the vertex cache
+	void AddQuads(TArray<uint32>& OutIndices, uint32 Stride, uint32 Min, uint32 Max) const;
+	// Add the strip between an edge and the interior of an LOD, the outer row uses the vertices of the coarser LOD
+	void CreateEdgeIndices(uint32 LOD, uint32 Edge, uint32 NeighborLOD);
+	// Add a triangle on an edge strip, T is the position along the edge and D is the distance from the edge
+	void AddEdgeTriangle(uint32 Edge, FIntPoint A, FIntPoint B, FIntPoint C);
+
+	// The size the topology was created for
+	uint32 Size;
+	// The vertex width of the mesh
+	uint32 Width;
+	// The number of LODs
+	uint32 NumLODs;
+	// Full resolution triangle indices
+	TArray<uint32> GridIndices;
+	// Interior and edge triangle indices for every LOD
+	TArray<uint32> Indices;
+	// The interior range of each LOD
+	TArray<FTerrainIndexRange> InteriorRanges;
+	// The edge ranges of each LOD, indexed by (LOD * terrain_num_edges + Edge) * NumLODs + NeighborLOD
+	TArray<FTerrainIndexRange> EdgeRanges;
+};
\ No newline at end of file
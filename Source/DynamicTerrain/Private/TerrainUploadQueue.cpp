@@ -0,0 +1,84 @@
+#include "TerrainUploadQueue.h"
+#include "TerrainRender.h"
+#include "TerrainStat.h"
+
+#include "Misc/ScopeLock.h"
+#include "RenderingThread.h"
+
+DECLARE_CYCLE_STAT(TEXT("Dynamic Terrain - Upload Vertex Data"), STAT_DynamicTerrain_UploadVertexData, STATGROUP_DynamicTerrain);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Dynamic Terrain - Proxies Uploaded"), STAT_DynamicTerrain_ProxiesUploaded, STATGROUP_DynamicTerrain);
+DECLARE_FLOAT_COUNTER_STAT(TEXT("Dynamic Terrain - Upload Throughput (MB/s)"), STAT_DynamicTerrain_UploadThroughput, STATGROUP_DynamicTerrain);
+
+void FTerrainUploadQueue::AddMapUpdate(FTerrainComponentSceneProxy* Proxy, TSharedPtr<FMapSection, ESPMode::ThreadSafe> Section)
+{
+	FScopeLock lock(&Lock);
+	Updates.FindOrAdd(Proxy).Section = Section;
+}
+
+void FTerrainUploadQueue::AddUVUpdate(FTerrainComponentSceneProxy* Proxy, int32 XOffset, int32 YOffset, float Tiling)
+{
+	FScopeLock lock(&Lock);
+
+	FUpdate& update = Updates.FindOrAdd(Proxy);
+	update.UpdateUVs = true;
+	update.XOffset = XOffset;
+	update.YOffset = YOffset;
+	update.Tiling = Tiling;
+}
+
+void FTerrainUploadQueue::Flush()
+{
+	{
+		FScopeLock lock(&Lock);
+		if (Updates.Num() == 0)
+		{
+			return;
+		}
+	}
+
+	// Updates added before the command runs are uploaded with this batch, later flushes find nothing left to do
+	TSharedRef<FTerrainUploadQueue, ESPMode::ThreadSafe> queue = AsShared();
+	ENQUEUE_RENDER_COMMAND(FTerrainUpload)([queue](FRHICommandListImmediate& RHICmdList) {
+		queue->Upload();
+		});
+}
+
+void FTerrainUploadQueue::RemoveProxy(FTerrainComponentSceneProxy* Proxy)
+{
+	FScopeLock lock(&Lock);
+	Updates.Remove(Proxy);
+}
+
+void FTerrainUploadQueue::Upload()
+{
+	SCOPE_CYCLE_COUNTER(STAT_DynamicTerrain_UploadVertexData);
+
+	TMap<FTerrainComponentSceneProxy*, FUpdate> updates;
+	{
+		FScopeLock lock(&Lock);
+		updates = MoveTemp(Updates);
+		Updates.Reset();
+	}
+
+	// Upload each proxy once with its newest data
+	double start_time = FPlatformTime::Seconds();
+	uint64 bytes = 0;
+	for (const TPair<FTerrainComponentSceneProxy*, FUpdate>& update : updates)
+	{
+		if (update.Value.Section.IsValid())
+		{
+			bytes += update.Key->UpdateMap(update.Value.Section);
+		}
+		if (update.Value.UpdateUVs)
+		{
+			bytes += update.Key->UpdateUVs(update.Value.XOffset, update.Value.YOffset, update.Value.Tiling);
+		}
+	}
+	double elapsed = FPlatformTime::Seconds() - start_time;
+
+	INC_DWORD_STAT_BY(STAT_DynamicTerrain_ProxiesUploaded, updates.Num());
+	if (elapsed > 0.0)
+	{
+		SET_FLOAT_STAT(STAT_DynamicTerrain_UploadThroughput, bytes / (1024.0 * 1024.0) / elapsed);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "CoreMinimal.h"
+
+class FTerrainComponentSceneProxy;
+struct FMapSection;
+
+// Vertex updates for the scene proxies of a terrain, queued on the game thread and uploaded in one batch on the rendering thread
+// Updates queued for the same proxy before the batch is uploaded are merged, so each vertex buffer is locked at most once per batch
+class FTerrainUploadQueue : public TSharedFromThis<FTerrainUploadQueue, ESPMode::ThreadSafe>
+{
+public:
+	// Queue new map data for a proxy, called on the game thread
+	void AddMapUpdate(FTerrainComponentSceneProxy* Proxy, TSharedPtr<FMapSection, ESPMode::ThreadSafe> Section);
+	// Queue new UVs for a proxy, called on the game thread
+	void AddUVUpdate(FTerrainComponentSceneProxy* Proxy, int32 XOffset, int32 YOffset, float Tiling);
+	// Send the queued updates to the rendering thread, called on the game thread once every update of a frame is queued
+	void Flush();
+	// Drop the updates of a proxy that is being destroyed, called on the rendering thread
+	void RemoveProxy(FTerrainComponentSceneProxy* Proxy);
+
+private:
+	// The pending changes of a single proxy
+	struct FUpdate
+	{
+		// The newest map data, null if the map hasn't changed
+		TSharedPtr<FMapSection, ESPMode::ThreadSafe> Section;
+		// Set when the UVs have changed
+		bool UpdateUVs = false;
+		int32 XOffset = 0;
+		int32 YOffset = 0;
+		float Tiling = 1.0f;
+	};
+
+	// Upload every queued update, called on the rendering thread
+	void Upload();
+
+	// Pending updates by proxy
+	TMap<FTerrainComponentSceneProxy*, FUpdate> Updates;
+	// Guards access to the pending updates
+	FCriticalSection Lock;
+};
\ No newline at end of file
@@ -2,6 +2,30 @@
 
 #include "CoreMinimal.h"
 
+// A counter-based random number generator, each value is a hash of the seed, the stream and an index
+// Values don't depend on the order they are drawn in, so any row, tile or point can be generated on its own and in parallel
+class FTerrainRandom
+{
+public:
+	FTerrainRandom(uint32 Seed, uint32 Stream = 0);
+
+	// Get an independent generator for a sub-stream, such as an octave, a tile or a foliage group
+	FTerrainRandom GetStream(uint32 Stream) const;
+
+	// Get random bits for an index
+	uint32 GetUInt(uint64 Index) const;
+	// Get a random value from 0 to 1 for an index
+	float GetFraction(uint64 Index) const;
+	// Get a random value from Min to Max for an index
+	float GetRange(uint64 Index, float Min, float Max) const;
+	// Get a random integer from Min to Max inclusive for an index
+	int32 GetInt(uint64 Index, int32 Min, int32 Max) const;
+
+private:
+	// The hashed seed and stream
+	uint64 Key;
+};
+
 // The base class for noise data
 class Noise
 {
@@ -34,11 +58,39 @@ public:
 
 	// Get Perlin noise at the specified coordinate
 	float Perlin(float X, float Y) const;
+	// Get Perlin noise at Count coordinates along a row, starting at X0 and stepping by 1
+	// Samples are evaluated four at a time and share the gradient lookups of each cell
+	void PerlinRow(float Y, float X0, int32 Count, float* OutValues) const;
 
 protected:
 	FVector2D* Gradient = nullptr;
 };
 
+// Gradient noise with gradients hashed from the seed and lattice coordinates instead of stored in a table
+// It can be sampled at any coordinate, including outside of the scaled area and at negative coordinates
+class HashGradientNoise : public Noise
+{
+public:
+	// Width and Height set the number of lattice cells stretched across the area passed to Scale
+	HashGradientNoise(uint32 NewWidth, uint32 NewHeight, uint32 Seed);
+	virtual ~HashGradientNoise() {};
+
+	virtual void Scale(uint32 SampleWidth, uint32 SampleHeight) override;
+	// Set the number of lattice cells per sample directly, independent of any sampled area
+	void SetFrequency(float Frequency);
+
+	// Get the gradient at a given lattice point
+	FVector2D GetGradient(int32 X, int32 Y) const;
+
+	// Get Perlin noise at the specified coordinate
+	float Perlin(float X, float Y) const;
+	// Get Perlin noise at Count coordinates along a row, starting at X0 and stepping by 1
+	void PerlinRow(float Y, float X0, int32 Count, float* OutValues) const;
+
+protected:
+	uint32 Seed = 0;
+};
+
 // Noise generated by creating a grid of random values
 class ValueNoise : public Noise
 {
@@ -84,16 +136,37 @@ public:
 	virtual inline FVector2D GetNearest(FVector2D Location) const;
 	// Get the distance from a given point to the nearest point
 	virtual inline float GetNearestDistance(FVector2D Location) const;
+	// Get the distances from a given point to the nearest and second nearest points, F1 and F2
+	FVector2D GetNearestDistances(FVector2D Location) const;
 
 	// Sample point noise at the given coordinates
 	virtual float Dot(float X, float Y) const;
 	// Sample raw Worley noise at the given coordinates
 	virtual float Worley(float X, float Y) const;
+	// Sample the difference between F2 and F1 at the given coordinates, which is zero on the edges of Voronoi cells
+	float WorleyEdge(float X, float Y) const;
 
 	virtual const TArray<FVector2D>& GetPoints();
 
 protected:
+	// Sort the points into a uniform grid of cells, called once the points have been generated
+	void BuildCells();
+	// Search the cells in rings around a location until no closer point can be found
+	// Gets the squared distances to the nearest and, if FindSecond is set, the second nearest points
+	void FindNearest(FVector2D Location, bool FindSecond, FVector2D& OutNearest, float& OutFirst, float& OutSecond) const;
+
 	TArray<FVector2D> Points;
+
+	// The corner and size of the cells points are sorted into
+	FVector2D CellOrigin = FVector2D::ZeroVector;
+	float CellSize = 1.0f;
+	// The number of cells along each axis
+	int32 CellsX = 0;
+	int32 CellsY = 0;
+	// The index in CellPoints of the first point in each cell, followed by the number of points
+	TArray<int32> CellStart;
+	// The points ordered by cell
+	TArray<FVector2D> CellPoints;
 };
 
 // Noise generated by plotting random points within each cell of a unit grid
@@ -128,12 +201,18 @@ protected:
 	// Create the sorting grid
 	void InitializeSortingGrid(float MinRadius);
 	// Add a point to the sorting grid
-	inline void SortPoint(int32 PointIndex);
+	inline void SortPoint(FVector2D Point);
+
+	// Fill the space with points using Bridson's algorithm, InSpace tests whether a point is inside of the space
+	// The sorting grid is split into tiles which are filled in parallel, and the points are collected afterwards
+	void Fill(TFunctionRef<bool(FVector2D)> InSpace, float SampleRadius, uint32 Seed);
+	// Fill a rectangle of sorting grid cells, starting from the points around it
+	void FillTile(const FIntRect& Tile, TFunctionRef<bool(FVector2D)> InSpace, float SampleRadius, const FTerrainRandom& Random);
 
 	// The size of each cell in the sorting grid
 	float GridBound;
 	// The dimensions of the sorting grid
 	uint32 GridWidth, GridHeight;
-	// A grid to store points for nearest neighbor searches
-	TArray<int32> SortingGrid;
+	// A grid to store points for nearest neighbor searches, cells are small enough to hold only one point each
+	TArray<FVector2D> SortingGrid;
 };
\ No newline at end of file
@@ -9,6 +9,9 @@
 #include "TerrainComponent.generated.h"
 
 class ATerrain;
+class FTerrainTopology;
+class FTerrainLODGrid;
+class FTerrainUploadQueue;
 
 UCLASS(HideCategories = (Object, LOD, Physics), EditInlineNew, ClassGroup = Rendering)
 class DYNAMICTERRAIN_API UTerrainComponent : public UMeshComponent, public IInterface_CollisionDataProvider
@@ -28,6 +31,9 @@ public:
 	virtual bool ContainsPhysicsTriMeshData(bool InUseAllTriData) const override { return true; }
 	virtual bool WantsNegXTriMesh() override { return false; }
 
+	virtual void PostLoad() override;
+	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
+
 private:
 	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
 
@@ -38,6 +44,8 @@ public:
 	void Initialize(ATerrain* Terrain, TSharedPtr<FMapSection, ESPMode::ThreadSafe> Proxy, int32 X, int32 Y);
 	// Initialize mesh data
 	void CreateMeshData();
+	// Build collision vertices from the map proxy
+	void GetVertices(TArray<FVector>& OutVertices);
 
 	// Set the size of the component
 	void SetSize(uint32 NewSize);
@@ -45,8 +53,10 @@ public:
 	inline uint32 GetSize();
 	// Set component tiling
 	void SetTiling(float NewTiling);
-	// Set LOD levels and scaling
-	void SetLODs(int32 NumLODs, float DistanceScale);
+	// Set LOD levels, distance scaling and the screen space error threshold
+	void SetLODs(int32 NumLODs, float DistanceScale, float ErrorThreshold);
+	// Set the number of coarser LODs used when drawing into shadow maps
+	void SetShadowLODBias(int32 Bias);
 	// Update rendering data from a heightmap section
 	void Update(TSharedPtr<FMapSection, ESPMode::ThreadSafe> NewSection);
 
@@ -54,6 +64,15 @@ public:
 	TSharedPtr<FMapSection, ESPMode::ThreadSafe> GetMapProxy();
 	// Set the map data for this section
 	void SetMapProxy(TSharedPtr<FMapSection, ESPMode::ThreadSafe> Proxy);
+	// Set the grid used to match LODs with neighboring components
+	void SetLODGrid(TSharedPtr<FTerrainLODGrid, ESPMode::ThreadSafe> Grid);
+	// Set the queue used to upload map and UV changes to the render thread
+	void SetUploadQueue(TSharedPtr<FTerrainUploadQueue, ESPMode::ThreadSafe> Queue);
+
+	// Cook collision synchronously if it doesn't match the current map data
+	void FinalizeCollision();
+	// Returns true if the collision body was cooked from the current map data
+	bool IsCollisionCurrent() const;
 
 	// Set to true to cook collision off the main thread
 	UPROPERTY()
@@ -62,20 +81,22 @@ public:
 private:
 	// Verify that the map proxy exists
 	void VerifyMapProxy();
+	// Recalculate the height range of the component from the map proxy
+	void UpdateHeightRange();
 
-	// Update collision data
-	void UpdateCollision();
+	// Update collision data, ForceSync ignores the async cooking setting
+	void UpdateCollision(bool ForceSync = false);
+	// Update the vertices of the existing collision body without recooking it
+	void UpdateCollisionVertices();
 	// Finish asynchronous collision cooking
 	void FinishCollision(bool Success, UBodySetup* NewBodySetup);
 	// Create a collision body
 	UBodySetup* CreateBodySetup();
+	// Get a collision GUID derived from the map data so identical sections share cooked data
+	FGuid GetCollisionGuid() const;
 
-	// The mesh indices
-	UPROPERTY(VisibleAnywhere)
-		TArray<uint32> IndexBuffer;
-	// The mesh vertices
-	UPROPERTY(VisibleAnywhere)
-		TArray<FVector> Vertices;
+	// The mesh indices, shared with other components of the same size
+	TSharedPtr<const FTerrainTopology, ESPMode::ThreadSafe> Topology;
 
 	// The size of the component
 	UPROPERTY(VisibleAnywhere)
@@ -95,6 +116,18 @@ private:
 	// The scaling factor for LOD transitions
 	UPROPERTY(VisibleAnywhere)
 		float LODScale;
+	// The screen space error in pixels allowed when selecting LODs
+	UPROPERTY(VisibleAnywhere)
+		float LODErrorThreshold;
+	// The number of coarser LODs used when drawing into shadow maps
+	UPROPERTY(VisibleAnywhere)
+		int32 ShadowLODBias;
+	// The lowest height of the component's vertices
+	UPROPERTY()
+		float MinHeight = 0.0f;
+	// The highest height of the component's vertices
+	UPROPERTY()
+		float MaxHeight = 0.0f;
 
 	// The collision body for the object
 	UPROPERTY(Instanced)
@@ -102,9 +135,18 @@ private:
 	// Queue of body setups that are being cooked asynchronously
 	UPROPERTY(Transient)
 		TArray<UBodySetup*> BodySetupQueue;
+	// Hash of the map section the collision body was cooked from
+	UPROPERTY()
+		uint32 CookedHash = 0;
+	// Hash of the map section the physics state currently reflects
+	uint32 LiveHash = 0;
 
 	// The render data for the terrain component
 	TSharedPtr<FMapSection, ESPMode::ThreadSafe> MapProxy;
+	// The bounds of neighboring components, shared with the other components of the terrain
+	TSharedPtr<FTerrainLODGrid, ESPMode::ThreadSafe> LODGrid;
+	// The queue batching vertex updates, shared with the other components of the terrain
+	TSharedPtr<FTerrainUploadQueue, ESPMode::ThreadSafe> UploadQueue;
 
 	friend class FTerrainComponentSceneProxy;
 };
\ No newline at end of file
@@ -3,10 +3,42 @@
 #include "TerrainHeightMap.h"
 
 #include "CoreMinimal.h"
+#include "HAL/ThreadSafeBool.h"
+#include "Async/TaskGraphInterfaces.h"
 
 #include "TerrainGenerator.generated.h"
 
 class ATerrain;
+class FTerrainGraph;
+
+// The state of a generator running in the background, shared between the worker and the thread that started it
+class DYNAMICTERRAIN_API FTerrainGenerationTask
+{
+public:
+	// Get the fraction of the work known so far that has been completed
+	float GetProgress() const;
+	// True once the result has been swapped into the terrain or discarded
+	bool IsComplete() const;
+	// True once Cancel has been called
+	bool IsCancelled() const;
+	// Stop generating as soon as possible and keep the terrain's current heightmap
+	void Cancel();
+
+	// Add units of work, called by generators as they start each step
+	void AddWork(int32 Units);
+	// Mark units of work as completed
+	void CompleteWork(int32 Units);
+
+private:
+	FThreadSafeCounter TotalWork;
+	FThreadSafeCounter CompletedWork;
+	FThreadSafeBool Cancelled = false;
+	FThreadSafeBool Complete = false;
+
+	friend class UMapGenerator;
+};
+
+typedef TSharedRef<FTerrainGenerationTask, ESPMode::ThreadSafe> FTerrainGenerationTaskRef;
 
 UCLASS()
 class DYNAMICTERRAIN_API UMapGenerator : public UObject
@@ -26,6 +58,27 @@ public:
 	// Set the RNG seed
 	void SetSeed(int32 NewSeed);
 
+	// Get the heightmap generators write to, which is a staging map while generating in the background
+	UHeightMap* GetMap() const;
+
+	/// Background Generation ///
+
+	// Run a generator on a worker thread into a staging copy of the heightmap
+	// When it finishes the staging map is swapped into the terrain on the game thread, the changed sections are updated and foliage is replaced
+	// Generator must only write to GetMap, OnComplete is called on the game thread with true if the result was swapped in
+	// Only one generation runs at a time, the running task is returned instead of starting another
+	FTerrainGenerationTaskRef GenerateAsync(TFunction<void()> Generator, TFunction<void(bool)> OnComplete = TFunction<void(bool)>());
+	// Run a generator function in the background, Command is the name of the function followed by its arguments
+	// The returned task is already complete if the command doesn't name a generator or has the wrong number of arguments
+	FTerrainGenerationTaskRef GenerateCommandAsync(const FString& Command, TFunction<void(bool)> OnComplete = TFunction<void(bool)>());
+	// True while a background generation is running
+	bool IsGenerating() const;
+	// False for generator functions called on the game thread while a background generation is running, which are ignored
+	bool CanGenerate() const;
+
+	// Cancel and finish a background generation that is running when the generator is destroyed
+	virtual void BeginDestroy() override;
+
 	// Flatten the heightmap
 	UFUNCTION(BlueprintCallable)
 		void Flat(float Height);
@@ -45,6 +98,15 @@ public:
 			UPARAM(meta = (Default = 0.5f)) float Persistence,
 			UPARAM(meta = (Default = 256)) float MaxHeight);
 
+	// Generate a map using multiple layers of perlin noise, then erode it with water droplets
+	UFUNCTION(BlueprintCallable)
+		void ErodedPerlin(
+			UPARAM(meta = (Default = 2)) int32 Frequency,
+			UPARAM(meta = (Default = 3)) int32 Octaves,
+			UPARAM(meta = (Default = 0.5f)) float Persistence,
+			UPARAM(meta = (Default = 256)) float MaxHeight,
+			UPARAM(meta = (Default = 200000)) int32 Droplets);
+
 	UFUNCTION(BlueprintCallable)
 		void TestGenerator(
 			UPARAM(meta = (Default = 2)) int32 BaseFrequency,
@@ -52,6 +114,15 @@ public:
 			UPARAM(meta = (Default = 50)) int32 DetailFrequency,
 			UPARAM(meta = (Default = 256)) float MaxHeight);
 
+	// Generate meandering mountain ranges over rolling hills using a generation graph
+	// The seed is kept, so changing one parameter only evaluates the stages that depend on it
+	UFUNCTION(BlueprintCallable)
+		void Mountains(
+			UPARAM(meta = (Default = 256)) int32 Wavelength,
+			UPARAM(meta = (Default = 6)) int32 Octaves,
+			UPARAM(meta = (Default = 32)) float WarpStrength,
+			UPARAM(meta = (Default = 256)) float MaxHeight);
+
 protected:
 	/// Map Generator Components ///
 
@@ -62,8 +133,31 @@ protected:
 	// Generate a heightmap using perlin noise
 	void MapPerlin(int32 Frequency, int32 Octaves, float Persistence, float MaxHeight);
 
+	// Erode the heightmap with a number of water droplets
+	void ErodeHydraulic(int32 Droplets);
+
 	// Generate random foliage on the terrain
 	void FoliageRandom(uint32 NumPoints);
 	// Generate foliage evenly distributed around the map
 	void FoliageUniform(uint32 XPoints, uint32 YPoints);
+
+	// Evaluates generation graphs, kept between generations so that the tiles of unchanged stages are reused
+	TSharedPtr<FTerrainGraph> Graph;
+
+	/// Background Generation ///
+
+	// Swap a finished background generation into the terrain and place its foliage, then call the completion callback
+	void FinishGeneration(TWeakObjectPtr<ATerrain> Target);
+
+	// The heightmap written by background generations
+	UPROPERTY()
+		UHeightMap* StagingMap = nullptr;
+	// The running background generation
+	TSharedPtr<FTerrainGenerationTask, ESPMode::ThreadSafe> CurrentTask;
+	// The worker of the running background generation
+	FGraphEventRef GenerateEvent;
+	// Called when the running background generation finishes
+	TFunction<void(bool)> CompleteCallback;
+	// Foliage placement requested by a background generation, run after its result is swapped in
+	TArray<TFunction<void()>> DeferredFoliage;
 };
\ No newline at end of file
@@ -0,0 +1,253 @@
+#pragma once
+
+#include "TerrainAlgorithms.h"
+
+#include "CoreMinimal.h"
+#include "Hash/CityHash.h"
+
+class UHeightMap;
+class FTerrainStage;
+class FTerrainSourceStage;
+
+typedef TSharedRef<const FTerrainStage, ESPMode::ThreadSafe> FTerrainStageRef;
+typedef TSharedRef<const FTerrainSourceStage, ESPMode::ThreadSafe> FTerrainSourceStageRef;
+
+// A rectangle of heightmap samples, tiles are evaluated and cached independently
+struct FTerrainTile
+{
+	FIntPoint Min = FIntPoint::ZeroValue;
+	FIntPoint Size = FIntPoint::ZeroValue;
+
+	int32 Num() const
+	{
+		return Size.X * Size.Y;
+	}
+
+	bool operator==(const FTerrainTile& Other) const
+	{
+		return Min == Other.Min && Size == Other.Size;
+	}
+
+	friend uint32 GetTypeHash(const FTerrainTile& Tile)
+	{
+		return HashCombine(GetTypeHash(Tile.Min), GetTypeHash(Tile.Size));
+	}
+};
+
+/// Stages ///
+
+// A stage of a terrain generation graph, which produces a value for every sample of a tile from the values of its inputs
+// Stages are immutable, a parameter is changed by creating a new stage so that the stages before it keep their cached tiles
+class DYNAMICTERRAIN_API FTerrainStage : public TSharedFromThis<FTerrainStage, ESPMode::ThreadSafe>
+{
+public:
+	virtual ~FTerrainStage() {}
+
+	// Get a 64 bit hash of the stage's parameters and inputs, stages with the same hash produce the same values
+	uint64 GetHash() const;
+	// Get the stages whose tiles are passed to Evaluate
+	const TArray<FTerrainStageRef>& GetInputs() const;
+
+	// Fill a tile with the stage's values, StageInputs holds the values of each input over the same tile
+	virtual void Evaluate(const FTerrainTile& Tile, TArrayView<const float* const> StageInputs, float* OutValues) const = 0;
+
+protected:
+	// ParameterHash identifies the type and parameters of the stage, the hashes of the inputs are added to it
+	FTerrainStage(TArray<FTerrainStageRef> NewInputs, uint64 ParameterHash);
+
+	// Add a block of memory to a hash
+	static uint64 HashBytes(uint64 Hash, const void* Data, SIZE_T Size)
+	{
+		return CityHash64WithSeed((const char*)Data, Size, Hash);
+	}
+
+	// Hash the name of a stage type together with its parameters, parameters are hashed by value so they must be plain numbers
+	template<typename... ParameterTypes>
+	static uint64 HashParameters(const TCHAR* Type, ParameterTypes... Parameters)
+	{
+		uint64 hash = HashBytes(0, Type, FCString::Strlen(Type) * sizeof(TCHAR));
+		uint64 parameter_hashes[] = { hash, (hash = HashBytes(hash, &Parameters, sizeof(Parameters)))... };
+		return parameter_hashes[sizeof...(Parameters)];
+	}
+
+	// The stages evaluated before this one
+	TArray<FTerrainStageRef> Inputs;
+	// The hash of the stage and every stage before it, wide enough that different stages don't share cached tiles
+	uint64 Hash;
+};
+
+// A stage which can be sampled at any position, so that it can be evaluated at displaced coordinates
+class DYNAMICTERRAIN_API FTerrainSourceStage : public FTerrainStage
+{
+public:
+	virtual void Evaluate(const FTerrainTile& Tile, TArrayView<const float* const> StageInputs, float* OutValues) const override;
+
+	// Get the value at a position
+	virtual float Sample(float X, float Y) const = 0;
+	// Get Count values along a row, starting at X0 and stepping by 1
+	virtual void SampleRow(float Y, float X0, int32 Count, float* OutValues) const;
+
+protected:
+	FTerrainSourceStage(uint64 ParameterHash);
+};
+
+// Gradient noise in the range -1 to 1 with one lattice cell per Wavelength samples
+class DYNAMICTERRAIN_API FTerrainNoiseStage : public FTerrainSourceStage
+{
+public:
+	FTerrainNoiseStage(float Wavelength, uint32 Seed);
+
+	virtual float Sample(float X, float Y) const override;
+	virtual void SampleRow(float Y, float X0, int32 Count, float* OutValues) const override;
+
+protected:
+	HashGradientNoise Gradient;
+};
+
+// Fractal Brownian motion, octaves of gradient noise at increasing frequency and decreasing amplitude
+class DYNAMICTERRAIN_API FTerrainFBMStage : public FTerrainSourceStage
+{
+public:
+	FTerrainFBMStage(float Wavelength, int32 Octaves, float Persistence, uint32 Seed);
+
+	virtual float Sample(float X, float Y) const override;
+	virtual void SampleRow(float Y, float X0, int32 Count, float* OutValues) const override;
+
+protected:
+	TArray<HashGradientNoise> Octaves;
+	TArray<float> Amplitudes;
+};
+
+// Ridged multifractal noise in the range 0 to 1, each octave is weighted by the ridges of the octave before it
+class DYNAMICTERRAIN_API FTerrainRidgedStage : public FTerrainSourceStage
+{
+public:
+	FTerrainRidgedStage(float Wavelength, int32 Octaves, float Persistence, uint32 Seed);
+
+	virtual float Sample(float X, float Y) const override;
+
+protected:
+	TArray<HashGradientNoise> Octaves;
+	TArray<float> Amplitudes;
+};
+
+// Sample a source at positions displaced by two gradient noises
+class DYNAMICTERRAIN_API FTerrainWarpStage : public FTerrainSourceStage
+{
+public:
+	FTerrainWarpStage(FTerrainSourceStageRef Source, float Wavelength, float Strength, uint32 Seed);
+
+	virtual float Sample(float X, float Y) const override;
+
+protected:
+	FTerrainSourceStageRef Source;
+	HashGradientNoise WarpX;
+	HashGradientNoise WarpY;
+	float Strength;
+};
+
+// Remap values through a piecewise linear curve, values outside of the curve are clamped to its ends
+class DYNAMICTERRAIN_API FTerrainCurveStage : public FTerrainStage
+{
+public:
+	FTerrainCurveStage(FTerrainStageRef Input, TArray<FVector2D> Points);
+
+	virtual void Evaluate(const FTerrainTile& Tile, TArrayView<const float* const> StageInputs, float* OutValues) const override;
+
+protected:
+	TArray<FVector2D> Points;
+};
+
+// Fade values from 0 at Min to 1 at Max with a smoothstep, used to mask blends
+class DYNAMICTERRAIN_API FTerrainMaskStage : public FTerrainStage
+{
+public:
+	FTerrainMaskStage(FTerrainStageRef Input, float Min, float Max);
+
+	virtual void Evaluate(const FTerrainTile& Tile, TArrayView<const float* const> StageInputs, float* OutValues) const override;
+
+protected:
+	float Min;
+	float Max;
+};
+
+// The ways a blend stage combines its two inputs
+enum class ETerrainBlendMode : uint8
+{
+	Replace,
+	Add,
+	Multiply,
+	Max,
+	Min
+};
+
+// Combine two inputs, the combined value is faded in over the first input by a mask or a constant alpha
+class DYNAMICTERRAIN_API FTerrainBlendStage : public FTerrainStage
+{
+public:
+	FTerrainBlendStage(FTerrainStageRef A, FTerrainStageRef B, ETerrainBlendMode Mode, float Alpha = 1.0f);
+	FTerrainBlendStage(FTerrainStageRef A, FTerrainStageRef B, FTerrainStageRef Mask, ETerrainBlendMode Mode);
+
+	virtual void Evaluate(const FTerrainTile& Tile, TArrayView<const float* const> StageInputs, float* OutValues) const override;
+
+protected:
+	ETerrainBlendMode Mode;
+	float Alpha;
+};
+
+/// Graph Evaluation ///
+
+// Evaluates stages lazily, tile by tile, and caches the values of every stage by its hash and tile
+// Evaluating a graph after changing one stage only evaluates that stage and the stages after it
+class DYNAMICTERRAIN_API FTerrainGraph
+{
+public:
+	// NewCacheBudget is the number of bytes of tile values kept, tiles are evicted as soon as it is exceeded
+	FTerrainGraph(SIZE_T NewCacheBudget = 256 * 1024 * 1024);
+	~FTerrainGraph();
+
+	// Get the values of a stage over a tile, can be called from any thread
+	TSharedRef<const TArray<float>, ESPMode::ThreadSafe> EvaluateTile(const FTerrainStageRef& Stage, const FTerrainTile& Tile);
+	// Evaluate a stage over the whole heightmap in parallel tiles, values are multiplied by Scale
+	void Generate(const FTerrainStageRef& Stage, UHeightMap* Map, float Scale = 1.0f, int32 TileSize = 64);
+
+	// Remove every cached tile
+	void ClearCache();
+
+private:
+	struct FCacheKey
+	{
+		uint64 Hash;
+		FTerrainTile Tile;
+
+		bool operator==(const FCacheKey& Other) const
+		{
+			return Hash == Other.Hash && Tile == Other.Tile;
+		}
+
+		friend uint32 GetTypeHash(const FCacheKey& Key)
+		{
+			return HashCombine(GetTypeHash(Key.Hash), GetTypeHash(Key.Tile));
+		}
+	};
+
+	struct FCacheEntry
+	{
+		TSharedPtr<const TArray<float>, ESPMode::ThreadSafe> Values;
+		// The value of UseCount when the entry was last used
+		uint64 LastUse = 0;
+	};
+
+	// Remove the least recently used tiles until the cache is below its budget, must be called with the lock held
+	void TrimCache();
+
+	// Cached tile values
+	TMap<FCacheKey, FCacheEntry> Cache;
+	// The number of bytes of cached values
+	SIZE_T CacheSize = 0;
+	SIZE_T CacheBudget;
+	// Incremented by each use of the cache, so entries can be ordered by their last use
+	uint64 UseCount = 0;
+	// Guards access to the cache
+	FCriticalSection Lock;
+};
\ No newline at end of file
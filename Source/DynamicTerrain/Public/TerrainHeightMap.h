@@ -1,6 +1,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "Misc/SecureHash.h"
 
 #include "TerrainHeightMap.generated.h"
 
@@ -17,6 +18,85 @@ struct FMapSection
 		Y = YWidth;
 		Data.SetNumZeroed(X * Y);
 	}
+
+	// Get a hash of the section contents
+	uint32 GetHash() const
+	{
+		return FCrc::MemCrc32(Data.GetData(), Data.Num() * sizeof(float), X);
+	}
+
+	// Get a 128 bit hash of the section contents, wide enough to key shared derived data
+	FGuid GetGuid() const
+	{
+		FSHA1 sha;
+		sha.Update((const uint8*)&X, sizeof(X));
+		sha.Update((const uint8*)&Y, sizeof(Y));
+		sha.Update((const uint8*)Data.GetData(), Data.Num() * sizeof(float));
+		sha.Final();
+
+		uint32 hash[5];
+		sha.GetHash((uint8*)hash);
+		return FGuid(hash[0], hash[1], hash[2], hash[3]);
+	}
+};
+
+// Parameters of a hydraulic erosion pass, heights and distances are in heightmap samples
+USTRUCT(BlueprintType)
+struct DYNAMICTERRAIN_API FHydraulicErosionSettings
+{
+	GENERATED_BODY()
+
+	// The number of water droplets simulated over the whole map
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int32 Droplets = 100000;
+	// The seed used to place droplets, the same seed and settings always erode a map the same way
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int32 Seed = 0;
+	// The maximum number of steps a droplet takes before it evaporates
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int32 MaxLifetime = 30;
+	// The radius of the area eroded around a droplet
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int32 Radius = 3;
+	// How much a droplet keeps its direction instead of following the slope, from 0 to 1
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float Inertia = 0.05f;
+	// The amount of sediment a droplet can carry for its speed, water and slope
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float SedimentCapacity = 4.0f;
+	// The sediment a droplet can always carry, which keeps flat areas eroding slowly
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float MinSedimentCapacity = 0.01f;
+	// The fraction of the free capacity eroded each step
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float ErodeSpeed = 0.3f;
+	// The fraction of the excess sediment deposited each step
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float DepositSpeed = 0.3f;
+	// The fraction of water lost each step
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float EvaporateSpeed = 0.01f;
+	// How quickly droplets speed up going downhill
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float Gravity = 4.0f;
+};
+
+// Parameters of a thermal erosion pass, which moves material down slopes steeper than the talus
+USTRUCT(BlueprintType)
+struct DYNAMICTERRAIN_API FThermalErosionSettings
+{
+	GENERATED_BODY()
+
+	// The number of times material is moved between neighbouring samples
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		int32 Iterations = 8;
+	// The largest stable height difference between neighbouring samples, the tangent of the talus angle times the sample spacing
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float Talus = 1.0f;
+	// How fast steep slopes settle, from 0 to 1, each iteration removes Strength / 4 of the excess between two neighbours
+	// Each sample exchanges with four neighbours at once, so removing more per pair could overshoot and oscillate
+	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+		float Strength = 0.5f;
 };
 
 UCLASS()
@@ -36,6 +116,13 @@ public:
 	UFUNCTION(BlueprintPure)
 		float BPGetHeight(int32 X, int32 Y) const;
 
+	// Erode the heightmap by simulating water droplets in parallel, the terrain must be updated afterwards
+	UFUNCTION(BlueprintCallable)
+		void ErodeHydraulic(const FHydraulicErosionSettings& Settings);
+	// Let steep slopes settle to the talus, the terrain must be updated afterwards
+	UFUNCTION(BlueprintCallable)
+		void ErodeThermal(const FThermalErosionSettings& Settings);
+
 	/// Native Functions ///
 
 	// Get a copy of a portion of the map
@@ -56,9 +143,22 @@ public:
 	// Set the height of the heightmap at the given vertex
 	inline void SetHeight(uint32 X, uint32 Y, float Height);
 
+	// Copy the size and heights of another heightmap
+	void CopyMap(const UHeightMap* Other);
+	// Swap the heights with another heightmap of the same size
+	// Returns the range of rows that differ between the two, or an empty range if they are the same or have different sizes
+	FIntRect SwapMap(UHeightMap* Other);
+
+	// Let steep slopes inside a region settle to the talus, material does not cross the edges of the region
+	// Cheap enough to run every frame on regions deformed during gameplay, followed by ATerrain::UpdateRange
+	void ErodeThermalRange(const FThermalErosionSettings& Settings, FIntRect Range);
+
 	inline int32 GetWidthX() const;
 	inline int32 GetWidthY() const;
 
+	// Get a hash of the heightmap contents
+	uint32 GetContentHash() const;
+
 protected:
 	// The height data for the map
 	UPROPERTY(VisibleAnywhere)
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "TerrainHeightMap.h"
+
+#include "CoreMinimal.h"
+#include "Components/MeshComponent.h"
+
+#include "TerrainQuadtreeComponent.generated.h"
+
+class ATerrain;
+
+// Renders a whole terrain as a quadtree of patches instead of one mesh per terrain component
+// Distant nodes cover many components with a single coarse patch and vertices morph between levels on the GPU
+UCLASS(HideCategories = (Object, LOD, Physics, Collision), ClassGroup = Rendering)
+class DYNAMICTERRAIN_API UTerrainQuadtreeComponent : public UMeshComponent
+{
+	GENERATED_BODY()
+
+	/// Mesh Component Interface ///
+
+public:
+	UTerrainQuadtreeComponent(const FObjectInitializer& ObjectInitializer);
+
+	virtual FPrimitiveSceneProxy* CreateSceneProxy() override;
+	virtual int32 GetNumMaterials() const override;
+
+private:
+	virtual FBoxSphereBounds CalcBounds(const FTransform& LocalToWorld) const override;
+
+	/// Terrain Interface ///
+
+public:
+	// Copy the layout and heights of the terrain
+	// The renderer is only rebuilt if the layout changed, otherwise the sections that changed are uploaded to it
+	void Initialize(ATerrain* Terrain);
+	// Update the heights covered by a single terrain component
+	void UpdateSection(int32 X, int32 Y, TSharedPtr<FMapSection, ESPMode::ThreadSafe> Section);
+
+	// Returns false if a heightmap is too large to fit in a texture, such terrains are drawn by their components
+	static bool IsMapSupported(const UHeightMap* Map);
+
+private:
+	// Copy the heights covered by a terrain component, borders included
+	void GetSection(UHeightMap* Map, int32 X, int32 Y, FMapSection& OutSection) const;
+
+	// The size of each terrain component
+	UPROPERTY(VisibleAnywhere)
+		uint32 Size = 0;
+	// The number of terrain components on the X axis
+	UPROPERTY(VisibleAnywhere)
+		int32 XWidth = 0;
+	// The number of terrain components on the Y axis
+	UPROPERTY(VisibleAnywhere)
+		int32 YWidth = 0;
+	// The UV Tiling of the terrain
+	UPROPERTY(VisibleAnywhere)
+		float Tiling = 1.0f;
+	// The range of each quadtree level, measured in node widths
+	UPROPERTY(VisibleAnywhere)
+		float RangeScale = 6.0f;
+	// The lowest height of the terrain
+	UPROPERTY()
+		float MinHeight = 0.0f;
+	// The highest height of the terrain
+	UPROPERTY()
+		float MaxHeight = 0.0f;
+	// The hash of each terrain component's heights as they were last sent to the scene proxy
+	TArray<uint32> SectionHashes;
+
+	friend class FTerrainQuadtreeSceneProxy;
+};
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include "EditorViewportClient.h"
 
 #include "EditorModeManager.h"
+#include "Framework/Notifications/NotificationManager.h"
+#include "Widgets/Notifications/SNotificationList.h"
 
 #define LOCTEXT_NAMESPACE "TerrainMode"
 
@@ -482,6 +484,7 @@ void FDynamicTerrainMode::ModeUpdate()
 			Settings->UVTiling = SelectedTerrain->GetTiling();
 			Settings->LODLevels = SelectedTerrain->GetNumLODs();
 			Settings->LODScale = SelectedTerrain->GetLODDistanceScale();
+			Settings->LODErrorThreshold = SelectedTerrain->GetLODErrorThreshold();
 		}
 		else if (CurrentMode->ModeID == TerrainModeID::FOLIAGE)
 		{
@@ -498,6 +501,7 @@ void FDynamicTerrainMode::ModeUpdate()
 		Settings->UVTiling = 1.0f;
 		Settings->LODLevels = 5;
 		Settings->LODScale = 0.5;
+		Settings->LODErrorThreshold = 1.0f;
 	}
 
 	((FDynamicTerrainModeToolkit*)GetToolkit().Get())->RefreshDetails();
@@ -512,6 +516,7 @@ void FDynamicTerrainMode::ResizeTerrain()
 			// Update everything
 			SelectedTerrain->SetTiling(Settings->UVTiling);
 			SelectedTerrain->SetLODs(Settings->LODLevels, Settings->LODScale);
+			SelectedTerrain->SetLODErrorThreshold(Settings->LODErrorThreshold);
 			SelectedTerrain->Resize(Settings->ComponentSize, Settings->WidthX, Settings->WidthY);
 		}
 		else
@@ -521,6 +526,10 @@ void FDynamicTerrainMode::ResizeTerrain()
 			{
 				SelectedTerrain->SetLODs(Settings->LODLevels, Settings->LODScale);
 			}
+			if (Settings->LODErrorThreshold != SelectedTerrain->GetLODErrorThreshold())
+			{
+				SelectedTerrain->SetLODErrorThreshold(Settings->LODErrorThreshold);
+			}
 			// Update UV settings
 			if (Settings->UVTiling != SelectedTerrain->GetTiling())
 			{
@@ -540,6 +549,7 @@ void FDynamicTerrainMode::CreateTerrain()
 	// Resize the new terrain
 	new_terrain->SetTiling(Settings->UVTiling);
 	new_terrain->SetLODs(Settings->LODLevels, Settings->LODScale);
+	new_terrain->SetLODErrorThreshold(Settings->LODErrorThreshold);
 	new_terrain->Resize(Settings->ComponentSize, Settings->WidthX, Settings->WidthY);
 
 	SelectTerrain(new_terrain);
@@ -567,7 +577,7 @@ void FDynamicTerrainMode::SelectTerrain(ATerrain* Terrain)
 
 void FDynamicTerrainMode::ProcessGenerateCommand(/*const TCHAR* Command*/)
 {
-	if (MapGen->Terrain == nullptr || CurrentGenerator == nullptr)
+	if (MapGen->Terrain == nullptr || CurrentGenerator == nullptr || MapGen->IsGenerating())
 		return;
 
 	// Get a new seed for the map generator
@@ -581,8 +591,7 @@ void FDynamicTerrainMode::ProcessGenerateCommand(/*const TCHAR* Command*/)
 		MapGen->SetSeed(Settings->Seed);
 	}
 
-
-	SelectedTerrain->DeleteFoliage();
+	// The terrain's foliage is replaced when the generated map is swapped in, so cancelling keeps the current foliage
 
 	// Create a console command using parameters from the settings panel
 	FString command(CurrentGenerator->Name.ToString());
@@ -601,10 +610,51 @@ void FDynamicTerrainMode::ProcessGenerateCommand(/*const TCHAR* Command*/)
 		}
 	}
 
-	// Run the script command passed into the function
-	MapGen->CallFunctionByNameWithArguments(*command, *GetGlobalLogSingleton(), MapGen, true);
+	// Run the command in the background, the generated map replaces the terrain's heightmap when it finishes
+	TSharedPtr<TWeakPtr<SNotificationItem>> notification_item = MakeShared<TWeakPtr<SNotificationItem>>();
+	FTerrainGenerationTaskRef task = MapGen->GenerateCommandAsync(command, [notification_item](bool Swapped) {
+		TSharedPtr<SNotificationItem> notification = notification_item->Pin();
+		if (notification.IsValid())
+		{
+			notification->SetText(Swapped ? LOCTEXT("GenerateComplete", "Terrain generated") : LOCTEXT("GenerateCancelled", "Terrain generation cancelled"));
+			notification->SetCompletionState(Swapped ? SNotificationItem::CS_Success : SNotificationItem::CS_Fail);
+			notification->ExpireAndFadeout();
+		}
+		});
 	GEngine->AddOnScreenDebugMessage(-1, 5.0f, FColor::Yellow, command);
-	SelectedTerrain->Refresh();
+
+	// The task is already complete if the command couldn't be run
+	if (task->IsComplete())
+	{
+		FNotificationInfo rejected_info(FText::Format(LOCTEXT("GenerateRejected", "Couldn't run generator {0}"), FText::FromName(CurrentGenerator->Name)));
+		rejected_info.ExpireDuration = 5.0f;
+		TSharedPtr<SNotificationItem> rejected = FSlateNotificationManager::Get().AddNotification(rejected_info);
+		if (rejected.IsValid())
+		{
+			rejected->SetCompletionState(SNotificationItem::CS_Fail);
+		}
+		return;
+	}
+
+	// Show the progress in a notification with a button to cancel the generation
+	FText generator_name = FText::FromName(CurrentGenerator->Name);
+	FNotificationInfo info(FText::GetEmpty());
+	info.Text = TAttribute<FText>::Create(TAttribute<FText>::FGetter::CreateLambda([task, generator_name]() {
+		return FText::Format(LOCTEXT("GenerateProgress", "Generating {0}... {1}"), generator_name, FText::AsPercent(task->GetProgress()));
+		}));
+	info.bFireAndForget = false;
+	info.ButtonDetails.Add(FNotificationButtonInfo(
+		LOCTEXT("GenerateCancel", "Cancel"),
+		LOCTEXT("GenerateCancelTooltip", "Stop generating and keep the current heightmap"),
+		FSimpleDelegate::CreateLambda([task]() { task->Cancel(); }),
+		SNotificationItem::CS_Pending));
+
+	TSharedPtr<SNotificationItem> notification = FSlateNotificationManager::Get().AddNotification(info);
+	if (notification.IsValid())
+	{
+		notification->SetCompletionState(SNotificationItem::CS_Pending);
+		*notification_item = notification;
+	}
 }
 
 void FDynamicTerrainMode::SelectGenerator(TSharedPtr<FTerrainGenerator> Generator)
@@ -88,6 +88,8 @@ public:
 		int32 LODLevels = 5;
 	UPROPERTY(EditAnywhere, Category = "Terrain Settings|LOD")
 		float LODScale = 0.5;
+	UPROPERTY(EditAnywhere, Category = "Terrain Settings|LOD")
+		float LODErrorThreshold = 1.0f;
 
 	UPROPERTY(EditAnywhere, Category = "Brush Settings")
 		float Size = 10.0f;